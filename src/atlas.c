@@ -0,0 +1,94 @@
+#include "atlas.h"
+#include <stdlib.h>
+#include <string.h>
+#include "blend565.h"
+#include "fontatlas.h"
+
+static_assert(FONTATLAS_FIRST == ATLAS_FIRST && FONTATLAS_LAST == ATLAS_LAST, "glyph range differs from src/fontatlas.h");
+
+// Non-zero pairs only, sorted by (prev, next)
+static int atlas_kerning(int prev, int c) {
+	int lo = 0, hi = FONTATLAS_KERNING;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		const struct atlas_kern_t *k = &fontatlas_kerning[mid];
+		if (k->prev == prev && k->next == c) return k->delta;
+		if (k->prev < prev || (k->prev == prev && k->next < c)) lo = mid + 1;
+		else hi = mid;
+	}
+	return 0;
+}
+
+bool atlas_supports(const SDL_PixelFormat *fmt) {
+	return fmt->BytesPerPixel == 2 && fmt->Rmask == 0xf800 && fmt->Gmask == 0x07e0 && fmt->Bmask == 0x001f;
+}
+
+int atlas_render(const char *text, struct atlas_mask_t *mask) {
+	// pass 1: pen positions and line width
+	int pen = 0, w = 0;
+	for (const char *p = text; *p; p++) {
+		if (*p < ATLAS_FIRST || *p > ATLAS_LAST) return -1;
+		const struct atlas_glyph_t *glyph = &fontatlas_glyphs[*p - ATLAS_FIRST];
+
+		if (p != text) pen += atlas_kerning(p[-1], *p);
+		else if (glyph->minx < 0) pen -= glyph->minx; // as SDL_ttf keeps the first glyph inside the surface
+
+		if (pen + glyph->minx + glyph->w > w) w = pen + glyph->minx + glyph->w;
+		pen += glyph->advance;
+		if (pen > w) w = pen;
+	}
+
+	mask->w = w;
+	mask->h = FONTATLAS_HEIGHT;
+	mask->data = (uint8_t *)calloc(w * FONTATLAS_HEIGHT + 1, 1);
+	if (mask->data == NULL) return -1;
+
+	// pass 2: copy the glyphs, rows outside the line are cut as SDL_ttf does
+	pen = 0;
+	for (const char *p = text; *p; p++) {
+		const struct atlas_glyph_t *glyph = &fontatlas_glyphs[*p - ATLAS_FIRST];
+
+		if (p != text) pen += atlas_kerning(p[-1], *p);
+		else if (glyph->minx < 0) pen -= glyph->minx;
+
+		const uint8_t *src = fontatlas_coverage + glyph->offset;
+		for (int row = 0; row < glyph->h; row++) {
+			int y = glyph->yoffset + row;
+			if (y < 0 || y >= FONTATLAS_HEIGHT) continue;
+
+			uint8_t *out = mask->data + y * w;
+			for (int col = 0; col < glyph->w; col++) {
+				// overlapping glyphs keep the stronger coverage
+				int x = pen + glyph->minx + col;
+				uint8_t a = src[row * glyph->w + col];
+				if (x >= 0 && a > out[x]) out[x] = a;
+			}
+		}
+
+		pen += glyph->advance;
+	}
+
+	return 0;
+}
+
+int atlas_blit(SDL_Surface *dst, int x, int y, const struct atlas_mask_t *mask, SDL_Color color) {
+	if (!atlas_supports(dst->format)) return -1;
+	if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) return -1;
+
+	const uint16_t c = (color.r >> 3) << 11 | (color.g >> 2) << 5 | color.b >> 3;
+	const SDL_Rect *clip = &dst->clip_rect;
+
+	int x0 = x < clip->x ? clip->x - x : 0;
+	int x1 = x + mask->w > clip->x + clip->w ? clip->x + clip->w - x : mask->w;
+	int y0 = y < clip->y ? clip->y - y : 0;
+	int y1 = y + mask->h > clip->y + clip->h ? clip->y + clip->h - y : mask->h;
+
+	for (int row = y0; row < y1 && x0 < x1; row++) {
+		const uint8_t *src = mask->data + row * mask->w;
+		uint16_t *out = (uint16_t *)((uint8_t *)dst->pixels + (y + row) * dst->pitch) + x;
+		blend565(out + x0, src + x0, x1 - x0, c);
+	}
+
+	if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+	return 0;
+}
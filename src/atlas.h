@@ -0,0 +1,44 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "sdl_loader.h"
+
+// Glyph atlas for draw_text(). The printable ASCII range of the UI font is
+// rasterized at build time into 8 bit coverage masks (src/ttf2atlas.c).
+// Lines are laid out from it with the placement rules of
+// TTF_RenderText_Blended (bearing, ascent, kerning) and blended straight
+// into the 16 bit screen.
+
+#define ATLAS_FIRST		' '
+#define ATLAS_LAST		'~'
+#define ATLAS_GLYPHS	(ATLAS_LAST - ATLAS_FIRST + 1)
+
+struct atlas_glyph_t {
+	uint32_t offset;	// into the coverage buffer
+	uint8_t w, h;
+	int8_t minx;		// left bearing
+	int8_t yoffset;		// top row below the line top (ascent - maxy)
+	uint8_t advance;
+};
+
+struct atlas_kern_t {
+	uint8_t prev, next;
+	int8_t delta;
+};
+
+struct atlas_mask_t {
+	int w, h;
+	uint8_t *data;		// w * h coverage, malloc'ed
+};
+
+// Whether atlas_blit() can draw into surfaces of this format (RGB565)
+bool atlas_supports(const SDL_PixelFormat *fmt);
+
+// Lays out a line of text into one coverage mask of the line height.
+// Returns -1 if text has characters outside of the atlas.
+int atlas_render(const char *text, struct atlas_mask_t *mask);
+
+// Blends a mask in the given color with its top left at x, y
+int atlas_blit(SDL_Surface *dst, int x, int y, const struct atlas_mask_t *mask, SDL_Color color);
+
+#endif
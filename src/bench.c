@@ -0,0 +1,32 @@
+#include "bench.h"
+
+#ifdef RETROFW_BENCH
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+const char *root_path(const char *path) {
+	// a few buffers, so a call can take more than one path
+	static char bufs[4][256];
+	static int next;
+
+	const char *root = getenv("RETROFW_ROOT");
+	if (root == NULL || path[0] != '/') return path;
+
+	char *buf = bufs[next++ % 4];
+	snprintf(buf, sizeof(bufs[0]), "%s%s", root, path);
+	return buf;
+}
+
+void bench_mark_exec() {
+	const char *fd = getenv("RETROFW_BENCH_FD");
+	if (fd == NULL) return;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	write(atoi(fd), &ns, sizeof(ns));
+}
+#endif
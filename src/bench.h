@@ -0,0 +1,19 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Hooks for the startup benchmark ('make bench'). Built with RETROFW_BENCH,
+// every file on the boot path is looked up below $RETROFW_ROOT and the time
+// of the launcher exec is written to the descriptor in $RETROFW_BENCH_FD.
+// Regular builds compile both away.
+
+#ifdef RETROFW_BENCH
+	const char *root_path(const char *path);
+	void bench_mark_exec();
+	#define ROOT(path)			root_path(path)
+	#define BENCH_MARK_EXEC()	bench_mark_exec()
+#else
+	#define ROOT(path)			(path)
+	#define BENCH_MARK_EXEC()
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+// Canvas scaler benchmark: checks every 2x variant of src/scale565.h
+// against the scalar reference on random rows, then times them on full
+// 320x240 to 640x480 frames.
+//
+// usage: bench_scale [fuzz rounds]
+
+#include "scale565.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FUZZ_ROUNDS		100000
+#define FUZZ_MAX_LEN	96
+#define BENCH_W			320
+#define BENCH_H			240
+#define BENCH_FRAMES	2000
+
+struct variant_t {
+	const char *name;
+	scale565_row_fn fn;
+};
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int fuzz(const struct variant_t *v, int rounds) {
+	uint16_t src[FUZZ_MAX_LEN + 1], ref[2 * FUZZ_MAX_LEN + 2], out[2 * FUZZ_MAX_LEN + 2];
+
+	for (int i = 0; i < rounds; i++) {
+		int n = rand() % (FUZZ_MAX_LEN + 1), skew = rand() & 1;
+		for (int j = 0; j < FUZZ_MAX_LEN + 1; j++)
+			src[j] = rand();
+		for (int j = 0; j < 2 * FUZZ_MAX_LEN + 2; j++)
+			ref[j] = out[j] = rand();
+
+		// skew tests unaligned source rows
+		scale565_row2x_scalar(ref, src + skew, n);
+		v->fn(out, src + skew, n);
+		if (memcmp(ref, out, sizeof(ref))) {
+			printf("%s: round %d, n %d differs\n", v->name, i, n);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	int rounds = argc > 1 ? atoi(argv[1]) : FUZZ_ROUNDS;
+
+	struct variant_t variants[3];
+	int count = 0;
+	variants[count++] = (struct variant_t){ "scalar", scale565_row2x_scalar };
+	variants[count++] = (struct variant_t){ "swar", scale565_row2x_swar };
+#ifdef SCALE565_SSE2
+	variants[count++] = (struct variant_t){ "sse2", scale565_row2x_sse2 };
+#endif
+
+	srand(1);
+	int failed = 0;
+	for (int i = 1; i < count; i++) {
+		if (fuzz(&variants[i], rounds) < 0) failed = 1;
+		else printf("%s: %d rounds match scalar\n", variants[i].name, rounds);
+	}
+
+	uint16_t *src = new uint16_t[BENCH_W * BENCH_H];
+	uint16_t *dst = new uint16_t[4 * BENCH_W * BENCH_H];
+	for (int i = 0; i < BENCH_W * BENCH_H; i++)
+		src[i] = rand();
+
+	printf("%-8s %12s %12s\n", "variant", "us/frame", "frames/s");
+	for (int i = 0; i < count; i++) {
+		uint64_t t = now_ns();
+		for (int f = 0; f < BENCH_FRAMES; f++) {
+			for (int y = 0; y < BENCH_H; y++) {
+				uint16_t *out = dst + 2 * y * 2 * BENCH_W;
+				variants[i].fn(out, src + y * BENCH_W, BENCH_W);
+				memcpy(out + 2 * BENCH_W, out, 4 * BENCH_W);
+			}
+		}
+		t = now_ns() - t;
+		printf("%-8s %12.1f %12.1f\n", variants[i].name, t / 1e3 / BENCH_FRAMES, BENCH_FRAMES * 1e9 / t);
+	}
+
+	delete[] src;
+	delete[] dst;
+	return failed;
+}
@@ -0,0 +1,209 @@
+// Startup benchmark: runs retrofw-bench (a host build with -DRETROFW_BENCH)
+// against a throwaway fake root and reports the time from fork() to the
+// launcher exec, plus the dynamic loader statistics of one run.
+//
+// usage: bench_startup ./retrofw-bench [runs]
+
+#include "gpio.h"
+#include "prefetch.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define BENCH_RUNS		200
+#define BENCH_WARMUP	3
+
+static char root[64];
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void mkpath(const char *path, mode_t mode) {
+	char p[256];
+	snprintf(p, sizeof(p), "%s%s", root, path);
+	mkdir(p, mode);
+}
+
+static int mkfile(const char *path, const char *data, mode_t mode) {
+	char p[256];
+	snprintf(p, sizeof(p), "%s%s", root, path);
+	int fd = open(p, O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if (fd < 0) return -1;
+	if (data != NULL) write(fd, data, strlen(data));
+	return fd;
+}
+
+// Everything the MODE_START path touches, with all boot keys released
+static int setup_root() {
+	strcpy(root, "/tmp/retrofw-bench.XXXXXX");
+	if (mkdtemp(root) == NULL) return -1;
+
+	const char *dirs[] = { "/boot", "/dev", "/media", "/media/mmcblk1p1", "/home", "/home/retrofw", "/usr", "/usr/bin", "/tmp" };
+	for (unsigned int i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+		mkpath(dirs[i], 0755);
+
+	// sparse stand-in for the GPIO registers
+	int fd = mkfile("/dev/mem", NULL, 0644);
+	if (fd < 0) return -1;
+	ftruncate(fd, GPIO_BASE + GPIO_PORTS * GPIO_PORT_SIZE);
+	for (int p = 0; p < GPIO_PORTS; p++) {
+		uint32_t level = gpio_port_low(p);
+		pwrite(fd, &level, sizeof(level), GPIO_BASE + p * GPIO_PORT_SIZE);
+	}
+	close(fd);
+
+	close(mkfile("/dev/mmcblk1", NULL, 0644));
+	close(mkfile("/dev/tty0", NULL, 0644));
+	close(mkfile("/usr/bin/gmenunx", "#!/bin/sh\nexit 0\n", 0755));
+	return 0;
+}
+
+static int rm_entry(const char *path, const struct stat *s, int flag, struct FTW *ftw) {
+	return remove(path);
+}
+
+// Time from fork() to the exec mark written by the child, in ns
+static int64_t run_once(const char *bin, bool lddebug) {
+	int pipefd[2];
+	if (pipe(pipefd) < 0) return -1;
+
+	char fd[16], ldout[128];
+	snprintf(fd, sizeof(fd), "%d", pipefd[1]);
+	snprintf(ldout, sizeof(ldout), "%s/tmp/lddebug", root);
+
+	uint64_t start = now_ns();
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(pipefd[0]);
+		setenv("RETROFW_ROOT", root, 1);
+		setenv("RETROFW_BENCH_FD", fd, 1);
+		if (lddebug) {
+			setenv("LD_DEBUG", "statistics", 1);
+			setenv("LD_DEBUG_OUTPUT", ldout, 1);
+		}
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+		dup2(null, STDERR_FILENO);
+		execl(bin, bin, NULL);
+		_exit(127);
+	}
+	close(pipefd[1]);
+	if (pid < 0) {
+		close(pipefd[0]);
+		return -1;
+	}
+
+	uint64_t mark = 0;
+	ssize_t len = read(pipefd[0], &mark, sizeof(mark));
+	close(pipefd[0]);
+	waitpid(pid, NULL, 0);
+
+	return len == sizeof(mark) ? (int64_t)(mark - start) : -1;
+}
+
+static void lddebug_report() {
+	char pattern[128];
+	snprintf(pattern, sizeof(pattern), "%s/tmp", root);
+
+	DIR *dir = opendir(pattern);
+	if (dir == NULL) return;
+
+	printf("\ndynamic loader (LD_DEBUG=statistics, one run):\n");
+
+	struct dirent *d;
+	while ((d = readdir(dir)) != NULL) {
+		if (strncmp(d->d_name, "lddebug.", 8)) continue;
+
+		char path[400], line[256];
+		snprintf(path, sizeof(path), "%s/%s", pattern, d->d_name);
+		FILE *f = fopen(path, "r");
+		if (f == NULL) continue;
+
+		// exec keeps the pid: retrofw-bench first, then the launcher it started
+		printf("  pid %s\n", d->d_name + 8);
+		while (fgets(line, sizeof(line), f)) {
+			char *msg = strchr(line, ':');
+			if (msg == NULL) continue;
+			while (*++msg == ' ' || *msg == '\t');
+			if (*msg && *msg != '\n' && strncmp(msg, "runtime linker", 14)) printf("  %s", msg);
+		}
+		fclose(f);
+	}
+	closedir(dir);
+}
+
+// The recorder runs detached for the prefetch window after the first boot
+static void wait_prefetch() {
+	char path[128];
+	snprintf(path, sizeof(path), "%s" PREFETCH_FILE, root);
+
+	struct stat s;
+	for (int i = 0; i < (PREFETCH_WINDOW_MS + 2000) / 100 && stat(path, &s) != 0; i++)
+		usleep(100 * 1000);
+}
+
+static double ms(int64_t ns) {
+	return ns / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("usage: %s ./retrofw-bench [runs]\n", argv[0]);
+		return 1;
+	}
+
+	const char *bin = argv[1];
+	int runs = argc > 2 ? atoi(argv[2]) : BENCH_RUNS;
+	if (runs < 1) runs = 1;
+
+	if (setup_root() < 0) {
+		perror("bench root");
+		return 1;
+	}
+
+	// first runs record the prefetch list and fill the page cache
+	for (int i = 0; i < BENCH_WARMUP; i++) {
+		if (run_once(bin, false) < 0) {
+			printf("%s never reached the launcher exec\n", bin);
+			nftw(root, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+			return 1;
+		}
+		if (i == 0) wait_prefetch();
+	}
+
+	int64_t *t = new int64_t[runs];
+	int n = 0;
+	double sum = 0;
+	for (int i = 0; i < runs; i++) {
+		int64_t ns = run_once(bin, false);
+		if (ns < 0) continue;
+		t[n++] = ns;
+		sum += ns;
+	}
+
+	if (n) {
+		std::sort(t, t + n);
+		printf("time to exec (ms) over %d runs:\n", n);
+		printf("  %-6s %8.3f\n  %-6s %8.3f\n  %-6s %8.3f\n  %-6s %8.3f\n  %-6s %8.3f\n  %-6s %8.3f\n",
+			"min", ms(t[0]), "p50", ms(t[n / 2]), "p90", ms(t[n * 90 / 100]),
+			"p99", ms(t[n * 99 / 100]), "max", ms(t[n - 1]), "mean", sum / n / 1e6);
+	}
+	delete[] t;
+
+	run_once(bin, true);
+	lddebug_report();
+
+	nftw(root, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+	return n ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include "blend565.h"
+#include <string.h>
+
+#if defined(BLEND565_SSE2) || defined(BLEND565_AVX2)
+	#include <immintrin.h>
+#endif
+
+void blend565_scalar(uint16_t *dst, const uint8_t *cov, int n, uint16_t color) {
+	const uint32_t cr = color >> 11, cg = color >> 5 & 0x3f, cb = color & 0x1f;
+
+	for (int i = 0; i < n; i++) {
+		uint32_t a = BLEND565_ALPHA(cov[i]), ia = 32 - a, d = dst[i];
+		uint32_t r = ((d >> 11) * ia + cr * a) >> 5;
+		uint32_t g = ((d >> 5 & 0x3f) * ia + cg * a) >> 5;
+		uint32_t b = ((d & 0x1f) * ia + cb * a) >> 5;
+		dst[i] = r << 11 | g << 5 | b;
+	}
+}
+
+// G moved to the upper half leaves 5 to 6 spare bits above every channel,
+// enough for the multiply by a weight of up to 32
+#define SPREAD_MASK	0x07e0f81f
+
+static inline uint32_t spread565(uint32_t p) {
+	return (p | p << 16) & SPREAD_MASK;
+}
+
+static inline uint32_t blend565_px(uint32_t d, uint32_t c, uint32_t a) {
+	uint32_t x = ((spread565(d) * (32 - a) + c * a) >> 5) & SPREAD_MASK;
+	return (x | x >> 16) & 0xffff;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	#define PAIR(lo, hi)	((lo) << 16 | (hi))
+	#define FIRST(w)		((w) >> 16)
+	#define SECOND(w)		((w) & 0xffff)
+#else
+	#define PAIR(lo, hi)	((lo) | (hi) << 16)
+	#define FIRST(w)		((w) & 0xffff)
+	#define SECOND(w)		((w) >> 16)
+#endif
+
+// Pixels go through memory as aligned pairs: rows of text are mostly
+// empty or fully covered, which is one 32 bit test and at most one store
+void blend565_swar(uint16_t *dst, const uint8_t *cov, int n, uint16_t color) {
+	const uint32_t c = spread565(color);
+	const uint32_t solid = PAIR((uint32_t)color, (uint32_t)color);
+
+	if (n > 0 && ((uintptr_t)dst & 2)) {
+		if (cov[0]) dst[0] = blend565_px(dst[0], c, BLEND565_ALPHA(cov[0]));
+		dst++, cov++, n--;
+	}
+
+	for (; n >= 2; n -= 2, dst += 2, cov += 2) {
+		uint32_t a0 = cov[0], a1 = cov[1];
+		if (!(a0 | a1)) continue;
+
+		uint32_t d;
+		if ((a0 & a1) == 255) {
+			d = solid;
+		} else {
+			memcpy(&d, dst, 4);
+			d = PAIR(blend565_px(FIRST(d), c, BLEND565_ALPHA(a0)), blend565_px(SECOND(d), c, BLEND565_ALPHA(a1)));
+		}
+		memcpy(dst, &d, 4);
+	}
+
+	if (n > 0 && cov[0]) dst[0] = blend565_px(dst[0], c, BLEND565_ALPHA(cov[0]));
+}
+
+#ifdef BLEND565_SSE2
+void blend565_sse2(uint16_t *dst, const uint8_t *cov, int n, uint16_t color) {
+	const __m128i zero = _mm_setzero_si128(), four = _mm_set1_epi16(4), w32 = _mm_set1_epi16(32);
+	const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+	const __m128i cr = _mm_set1_epi16(color >> 11), cg = _mm_set1_epi16(color >> 5 & 0x3f), cb = _mm_set1_epi16(color & 0x1f);
+
+	for (; n >= 8; n -= 8, dst += 8, cov += 8) {
+		__m128i a = _mm_loadl_epi64((const __m128i *)cov);
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) & 0xff) == 0xff) continue;
+
+		a = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), four), 3);
+		__m128i ia = _mm_sub_epi16(w32, a);
+
+		__m128i d = _mm_loadu_si128((const __m128i *)dst);
+		__m128i r = _mm_srli_epi16(d, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(d, 5), m6);
+		__m128i b = _mm_and_si128(d, m5);
+
+		r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, ia), _mm_mullo_epi16(cr, a)), 5);
+		g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, ia), _mm_mullo_epi16(cg, a)), 5);
+		b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, ia), _mm_mullo_epi16(cb, a)), 5);
+
+		d = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+		_mm_storeu_si128((__m128i *)dst, d);
+	}
+
+	blend565_scalar(dst, cov, n, color);
+}
+#endif
+
+#ifdef BLEND565_AVX2
+__attribute__((target("avx2")))
+void blend565_avx2(uint16_t *dst, const uint8_t *cov, int n, uint16_t color) {
+	const __m256i four = _mm256_set1_epi16(4), w32 = _mm256_set1_epi16(32);
+	const __m256i m5 = _mm256_set1_epi16(0x1f), m6 = _mm256_set1_epi16(0x3f);
+	const __m256i cr = _mm256_set1_epi16(color >> 11), cg = _mm256_set1_epi16(color >> 5 & 0x3f), cb = _mm256_set1_epi16(color & 0x1f);
+
+	for (; n >= 16; n -= 16, dst += 16, cov += 16) {
+		__m128i a8 = _mm_loadu_si128((const __m128i *)cov);
+		if (_mm_testz_si128(a8, a8)) continue;
+
+		__m256i a = _mm256_srli_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(a8), four), 3);
+		__m256i ia = _mm256_sub_epi16(w32, a);
+
+		__m256i d = _mm256_loadu_si256((const __m256i *)dst);
+		__m256i r = _mm256_srli_epi16(d, 11);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(d, 5), m6);
+		__m256i b = _mm256_and_si256(d, m5);
+
+		r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, ia), _mm256_mullo_epi16(cr, a)), 5);
+		g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, ia), _mm256_mullo_epi16(cg, a)), 5);
+		b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(b, ia), _mm256_mullo_epi16(cb, a)), 5);
+
+		d = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), b);
+		_mm256_storeu_si256((__m256i *)dst, d);
+	}
+
+	blend565_scalar(dst, cov, n, color);
+}
+
+bool blend565_has_avx2() {
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+void blend565(uint16_t *dst, const uint8_t *cov, int n, uint16_t color) {
+#if defined(BLEND565_AVX2) && defined(BLEND565_SSE2)
+	static const blend565_fn kernel = blend565_has_avx2() ? blend565_avx2 : blend565_sse2;
+	kernel(dst, cov, n, color);
+#elif defined(BLEND565_SSE2)
+	blend565_sse2(dst, cov, n, color);
+#else
+	blend565_swar(dst, cov, n, color);
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef BLEND565_H
+#define BLEND565_H
+
+#include <stdint.h>
+
+// Blends a solid color into a row of RGB565 pixels, weighted by 8 bit
+// coverage. Coverage is reduced to 0..32 first, every channel then takes
+// (dst * (32 - a) + color * a) >> 5, so all variants below give the same
+// pixels: the SWAR one for the MIPS32 target and SSE2/AVX2 for host builds,
+// which 'make bench-blend' compares against the scalar reference.
+
+#if defined(__x86_64__) || defined(__i386__)
+	#if defined(__SSE2__)
+		#define BLEND565_SSE2
+	#endif
+	#if defined(__GNUC__)
+		#define BLEND565_AVX2	// runtime checked, see blend565()
+	#endif
+#endif
+
+// Coverage to blend weight, 0 and 255 map to 0 and 32
+#define BLEND565_ALPHA(a)	(((a) + 4) >> 3)
+
+typedef void (*blend565_fn)(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+
+void blend565_scalar(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+void blend565_swar(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+#ifdef BLEND565_SSE2
+void blend565_sse2(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+#endif
+#ifdef BLEND565_AVX2
+void blend565_avx2(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+bool blend565_has_avx2();
+#endif
+
+// The fastest variant for this CPU
+void blend565(uint16_t *dst, const uint8_t *cov, int n, uint16_t color);
+
+#endif
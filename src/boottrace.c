@@ -0,0 +1,125 @@
+#include "boottrace.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char *trace_names[TRACE_COUNT] = {
+	"kernel",
+	"date_time",
+	"gpio",
+	"check_part",
+	"ui_init",
+	"swapon",
+	"total",
+};
+
+static struct boottrace_t trace;
+static uint64_t trace_start;
+static uint64_t trace_begins[TRACE_COUNT];
+
+static uint64_t now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void trace_init() {
+	trace_start = now_us();
+	memset(&trace, 0, sizeof(trace));
+	trace.magic = BOOTTRACE_MAGIC;
+	trace.version = BOOTTRACE_VERSION;
+	trace.phase_us[TRACE_KERNEL] = trace_start;
+}
+
+void trace_begin(int phase) {
+	trace_begins[phase] = now_us();
+}
+
+void trace_end(int phase) {
+	trace.phase_us[phase] += now_us() - trace_begins[phase];
+}
+
+static int trace_valid(const struct boottrace_t *t) {
+	return t->magic == BOOTTRACE_MAGIC && t->version == BOOTTRACE_VERSION;
+}
+
+static int trace_load(struct boottrace_t slots[BOOTTRACE_SLOTS]) {
+	memset(slots, 0, sizeof(struct boottrace_t) * BOOTTRACE_SLOTS);
+
+	int fd = open(ROOT(BOOTTRACE_FILE), O_RDONLY);
+	if (fd < 0) return -1;
+	read(fd, slots, sizeof(struct boottrace_t) * BOOTTRACE_SLOTS);
+	close(fd);
+	return 0;
+}
+
+void trace_save(int mode) {
+	struct boottrace_t slots[BOOTTRACE_SLOTS];
+	trace_load(slots);
+
+	uint32_t seq = 0;
+	for (int i = 0; i < BOOTTRACE_SLOTS; i++) {
+		if (trace_valid(&slots[i]) && slots[i].seq >= seq)
+			seq = slots[i].seq + 1;
+	}
+
+	trace.seq = seq;
+	trace.mode = mode;
+	trace.phase_us[TRACE_TOTAL] = now_us() - trace_start;
+
+	int fd = open(ROOT(BOOTTRACE_FILE), O_WRONLY | O_CREAT, 0644);
+	if (fd < 0) return;
+	pwrite(fd, &trace, sizeof(trace), (seq % BOOTTRACE_SLOTS) * sizeof(trace));
+	close(fd);
+}
+
+void trace_report(int last) {
+	struct boottrace_t slots[BOOTTRACE_SLOTS];
+	if (trace_load(slots) < 0) {
+		printf("No boot trace in %s\n", BOOTTRACE_FILE);
+		return;
+	}
+
+	if (last <= 0 || last > BOOTTRACE_SLOTS) last = BOOTTRACE_SLOTS;
+
+	uint32_t newest = 0;
+	int count = 0;
+	for (int i = 0; i < BOOTTRACE_SLOTS; i++) {
+		if (!trace_valid(&slots[i])) continue;
+		if (!count || slots[i].seq > newest) newest = slots[i].seq;
+		count++;
+	}
+
+	if (!count) {
+		printf("No boot trace in %s\n", BOOTTRACE_FILE);
+		return;
+	}
+
+	printf("%-12s %8s %8s %8s %8s %5s\n", "phase (ms)", "last", "min", "avg", "max", "boots");
+
+	for (int p = 0; p < TRACE_COUNT; p++) {
+		uint32_t min = UINT32_MAX, max = 0, cur = 0;
+		uint64_t sum = 0;
+		int n = 0;
+
+		for (int i = 0; i < BOOTTRACE_SLOTS; i++) {
+			const struct boottrace_t *t = &slots[i];
+			if (!trace_valid(t) || newest - t->seq >= (uint32_t)last || !t->phase_us[p]) continue;
+
+			uint32_t us = t->phase_us[p];
+			if (us < min) min = us;
+			if (us > max) max = us;
+			if (t->seq == newest) cur = us;
+			sum += us;
+			n++;
+		}
+
+		if (!n) continue;
+
+		printf("%-12s %8.1f %8.1f %8.1f %8.1f %5d\n", trace_names[p],
+			cur / 1000.0, min / 1000.0, sum / n / 1000.0, max / 1000.0, n);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef BOOTTRACE_H
+#define BOOTTRACE_H
+
+#include <stdint.h>
+
+// Boot timeline tracer. Each phase of main() is timed with CLOCK_MONOTONIC
+// into a fixed record which is appended to a small ring file right before
+// the launcher is exec'ed (or the first recovery screen is shown).
+
+#define BOOTTRACE_FILE		"/boot/.boottrace"
+#define BOOTTRACE_SLOTS		16
+#define BOOTTRACE_MAGIC		0x43525442 // "BTRC"
+#define BOOTTRACE_VERSION	1
+
+enum trace_phases {
+	TRACE_KERNEL,		// kernel boot until main()
+	TRACE_DATE_TIME,
+	TRACE_GPIO,
+	TRACE_CHECK_PART,
+	TRACE_UI_INIT,		// sdl_init(), font and background
+	TRACE_SWAPON,
+	TRACE_TOTAL,		// main() until exec or first screen
+	TRACE_COUNT
+};
+
+struct boottrace_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t mode;
+	uint32_t seq;
+	uint32_t phase_us[TRACE_COUNT]; // 0 when the phase didn't run
+};
+
+void trace_init();
+void trace_begin(int phase);
+void trace_end(int phase);
+void trace_save(int mode);
+void trace_report(int last);
+
+#endif
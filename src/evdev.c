@@ -0,0 +1,240 @@
+#include <linux/input.h>
+// linux/input.h names gamepad buttons like src/keymap.h, only the latter
+// are meant below
+#undef BTN_A
+#undef BTN_B
+#undef BTN_X
+#undef BTN_Y
+#undef BTN_START
+#undef BTN_SELECT
+#undef BTN_LEFT
+#undef BTN_RIGHT
+
+#include "evdev.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+// 32-bit headers with a 64-bit time_t don't have input_event.time
+#ifndef input_event_sec
+	#define input_event_sec		time.tv_sec
+	#define input_event_usec	time.tv_usec
+#endif
+
+// Codes of the RetroFW keypad driver, the keys SDL translates them to
+static const struct {
+	uint16_t key;
+	uint16_t code;
+	bool repeat;
+	const char *name;
+} keypad[] = {
+	{ BTN_A,			KEY_LEFTCTRL,	false,	"A" },
+	{ BTN_B,			KEY_LEFTALT,	false,	"B" },
+	{ BTN_X,			KEY_SPACE,		false,	"X" },
+	{ BTN_Y,			KEY_LEFTSHIFT,	false,	"Y" },
+	{ BTN_L,			KEY_TAB,		false,	"L" },
+	{ BTN_R,			KEY_BACKSPACE,	false,	"R" },
+	{ BTN_START,		KEY_ENTER,		false,	"START" },
+	{ BTN_SELECT,		KEY_ESC,		false,	"SELECT" },
+	{ BTN_BACKLIGHT,	KEY_3,			false,	"BACKLIGHT" },
+	{ BTN_POWER,		KEY_END,		false,	"POWER" },
+	{ BTN_UP,			KEY_UP,			true,	"UP" },
+	{ BTN_DOWN,			KEY_DOWN,		true,	"DOWN" },
+	{ BTN_LEFT,			KEY_LEFT,		false,	"LEFT" },
+	{ BTN_RIGHT,		KEY_RIGHT,		false,	"RIGHT" },
+};
+
+#define KEYPAD_KEYS (sizeof(keypad) / sizeof(keypad[0]))
+
+static struct {
+	struct pollfd fd[EVDEV_MAX];
+	clockid_t clock[EVDEV_MAX];	// of the timestamps, monotonic unless the kernel is too old
+	int count;
+
+	uint32_t delay_us, interval_us, min_us;
+
+	int held;			// keypad index of the repeating key, -1 if none
+	uint64_t next_us;	// of its next repeat
+	uint32_t step_us;
+
+	uint32_t events, repeats;
+	uint32_t min_latency, max_latency;
+	uint64_t total_latency;
+} in;
+
+static uint64_t clock_us(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int keypad_find(uint16_t code) {
+	for (unsigned int i = 0; i < KEYPAD_KEYS; i++)
+		if (keypad[i].code == code) return i;
+	return -1;
+}
+
+static const char *key_name(uint16_t key) {
+	for (unsigned int i = 0; i < KEYPAD_KEYS; i++)
+		if (keypad[i].key == key) return keypad[i].name;
+	return "?";
+}
+
+// Skips keyboards, touchscreens and the like without any keypad key
+static bool has_keypad(int fd) {
+	uint8_t bits[KEY_MAX / 8 + 1];
+	memset(bits, 0, sizeof(bits));
+	if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(bits)), bits) < 0) return false;
+
+	for (unsigned int i = 0; i < KEYPAD_KEYS; i++)
+		if (bits[keypad[i].code / 8] >> (keypad[i].code % 8) & 1) return true;
+	return false;
+}
+
+int evdev_open() {
+	evdev_close();
+	memset(&in, 0, sizeof(in));
+	in.held = -1;
+
+	uint32_t delay = EVDEV_DELAY_MS, interval = EVDEV_REPEAT_MS, min = EVDEV_REPEAT_MIN_MS;
+	const char *repeat = getenv("RETROFW_REPEAT");
+	if (repeat != NULL) sscanf(repeat, "%u,%u,%u", &delay, &interval, &min);
+	if (min > interval) min = interval;
+	in.delay_us = delay * 1000;
+	in.interval_us = interval * 1000;
+	in.min_us = min * 1000;
+
+	glob_t g;
+	if (glob(ROOT(EVDEV_GLOB), 0, NULL, &g)) return 0;
+
+	for (size_t i = 0; i < g.gl_pathc && in.count < EVDEV_MAX; i++) {
+		int fd = open(g.gl_pathv[i], O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) continue;
+		if (!has_keypad(fd)) {
+			close(fd);
+			continue;
+		}
+
+		in.clock[in.count] = CLOCK_REALTIME;
+#ifdef EVIOCSCLOCKID
+		int clock = CLOCK_MONOTONIC;
+		if (ioctl(fd, EVIOCSCLOCKID, &clock) == 0) in.clock[in.count] = CLOCK_MONOTONIC;
+#endif
+		in.fd[in.count].fd = fd;
+		in.fd[in.count].events = POLLIN;
+		in.count++;
+	}
+	globfree(&g);
+
+	return in.count;
+}
+
+void evdev_close() {
+	for (int i = 0; i < in.count; i++)
+		close(in.fd[i].fd);
+	in.count = 0;
+	in.held = -1;
+}
+
+bool evdev_poll(struct evdev_event_t *e) {
+	struct input_event ev;
+
+	for (int d = 0; d < in.count; d++) {
+		while (read(in.fd[d].fd, &ev, sizeof(ev)) == sizeof(ev)) {
+			// value 2 is the kernel's autorepeat
+			if (ev.type != EV_KEY || ev.value > 1) continue;
+			int k = keypad_find(ev.code);
+			if (k < 0) continue;
+
+			uint64_t t = (uint64_t)ev.input_event_sec * 1000000 + ev.input_event_usec;
+			uint64_t now = clock_us(in.clock[d]);
+			uint32_t latency = now > t ? now - t : 0;
+
+			if (!in.events || latency < in.min_latency) in.min_latency = latency;
+			if (latency > in.max_latency) in.max_latency = latency;
+			in.total_latency += latency;
+			in.events++;
+
+			if (ev.value && keypad[k].repeat) {
+				// repeats count from the press, not from when it was read
+				in.held = k;
+				in.step_us = in.interval_us;
+				in.next_us = clock_us(CLOCK_MONOTONIC) - latency + in.delay_us;
+			} else if (!ev.value && in.held == k) {
+				in.held = -1;
+			}
+
+			e->key = keypad[k].key;
+			e->state = ev.value ? SDL_PRESSED : SDL_RELEASED;
+			e->repeat = false;
+			e->latency_us = latency;
+			return true;
+		}
+	}
+
+	if (in.held < 0) return false;
+	uint64_t now = clock_us(CLOCK_MONOTONIC);
+	if (now < in.next_us) return false;
+
+	// a late reader gets one repeat, not a burst of the missed ones
+	in.next_us = (now - in.next_us > in.step_us ? now : in.next_us) + in.step_us;
+	in.step_us = in.step_us * EVDEV_ACCEL / 100;
+	if (in.step_us < in.min_us) in.step_us = in.min_us;
+	in.repeats++;
+
+	e->key = keypad[in.held].key;
+	e->state = SDL_PRESSED;
+	e->repeat = true;
+	e->latency_us = 0;
+	return true;
+}
+
+void evdev_wait(uint32_t ms) {
+	int timeout = ms;
+	if (in.held >= 0) {
+		uint64_t now = clock_us(CLOCK_MONOTONIC);
+		uint32_t due = in.next_us > now ? (in.next_us - now + 999) / 1000 : 0;
+		if (due < ms) timeout = due;
+	}
+
+	if (in.count) poll(in.fd, in.count, timeout);
+	else if (timeout) usleep(timeout * 1000);
+}
+
+int evdev_report(uint32_t frame_ms, uint32_t seconds) {
+	if (evdev_open() == 0) {
+		printf("No keypad at %s\n", EVDEV_GLOB);
+		return 1;
+	}
+
+	printf("%d device(s), repeat after %u ms every %u..%u ms, ", in.count,
+		in.delay_us / 1000, in.interval_us / 1000, in.min_us / 1000);
+	if (frame_ms) printf("read every %u ms\n", frame_ms);
+	else printf("woken by events\n");
+	printf("%-10s %-6s %10s\n", "key", "event", "latency us");
+
+	struct evdev_event_t e;
+	uint64_t end = clock_us(CLOCK_MONOTONIC) + (uint64_t)seconds * 1000000;
+	while (clock_us(CLOCK_MONOTONIC) < end) {
+		while (evdev_poll(&e))
+			printf("%-10s %-6s %10u\n", key_name(e.key), e.repeat ? "repeat" : e.state ? "down" : "up", e.latency_us);
+		fflush(stdout);
+
+		if (frame_ms) usleep(frame_ms * 1000);
+		else evdev_wait(100);
+	}
+
+	if (in.events) {
+		printf("%u events: latency min %u, avg %u, max %u us; %u repeats\n", in.events, in.min_latency,
+			(uint32_t)(in.total_latency / in.events), in.max_latency, in.repeats);
+	}
+	evdev_close();
+	return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef EVDEV_H
+#define EVDEV_H
+
+#include <stdint.h>
+#include "keymap.h"
+
+// Keypad input read straight from the kernel's event devices, without SDL's
+// keyboard translation. Every event carries the kernel timestamp of the key
+// change, which gives the latency until the UI sees it. UP and DOWN repeat
+// while held: after a delay, then every interval, which shrinks with every
+// repeat down to a minimum. The kernel's own autorepeat is ignored.
+// RETROFW_REPEAT=<delay>,<interval>,<minimum> overrides the defaults (ms).
+
+#define EVDEV_GLOB			"/dev/input/event*"
+#define EVDEV_MAX			4		// devices
+#define EVDEV_DELAY_MS		300		// a held key starts repeating
+#define EVDEV_REPEAT_MS		150		// first repeat interval
+#define EVDEV_REPEAT_MIN_MS	40
+#define EVDEV_ACCEL			80		// percent of the previous interval
+
+struct evdev_event_t {
+	uint16_t key;			// BTN_*
+	uint8_t state;			// SDL_PRESSED or SDL_RELEASED
+	bool repeat;
+	uint32_t latency_us;	// kernel timestamp to evdev_poll(), 0 for repeats
+};
+
+// Opens every event device which reports keypad keys, returns how many
+int evdev_open();
+void evdev_close();
+
+// Next key event, false if there is none yet
+bool evdev_poll(struct evdev_event_t *e);
+
+// Sleeps up to ms, returns early when a key changes or a repeat is due
+void evdev_wait(uint32_t ms);
+
+// Prints every event and the latency for seconds. frame_ms > 0 reads the
+// devices once per frame like a frame-polled loop, 0 wakes on every event.
+int evdev_report(uint32_t frame_ms, uint32_t seconds);
+
+#endif
@@ -0,0 +1,281 @@
+#include "exec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+uint32_t now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void exec_log_step(const char *step, int status, uint32_t ms) {
+#ifndef TARGET_RETROFW
+	printf("exec: %6u ms  status %3d  %s\n", ms, status, step);
+#endif
+
+	FILE *f = fopen(EXEC_LOG_FILE, "a");
+	if (f == NULL) return;
+	fprintf(f, "%6u ms  status %3d  %s\n", ms, status, step);
+	fclose(f);
+}
+
+static void exec_log(const char *const argv[], const struct exec_t *res) {
+	char cmd[256] = "";
+	for (int i = 0; argv[i] != NULL; i++) {
+		if (i) strncat(cmd, " ", sizeof(cmd) - strlen(cmd) - 1);
+		strncat(cmd, argv[i], sizeof(cmd) - strlen(cmd) - 1);
+	}
+	if (res->input_err) {
+		strncat(cmd, " < ", sizeof(cmd) - strlen(cmd) - 1);
+		strncat(cmd, strerror(res->input_err), sizeof(cmd) - strlen(cmd) - 1);
+	}
+
+	exec_log_step(cmd, res->status, res->ms);
+}
+
+// Writes all of data to the command's stdin, 0 or the errno. A tool which
+// exits or closes stdin early raises SIGPIPE, which is blocked on this
+// thread meanwhile and dropped instead of killing recovery.
+static int exec_feed(int fd, const char *data, size_t len) {
+	sigset_t pipe, old, pending;
+	sigemptyset(&pipe);
+	sigaddset(&pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe, &old);
+
+	int err = 0;
+	while (len) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			err = errno;
+			break;
+		}
+		data += n;
+		len -= n;
+	}
+
+	if (err == EPIPE && !sigismember(&old, SIGPIPE)) {
+		struct timespec zero = { 0, 0 };
+		sigpending(&pending);
+		if (sigismember(&pending, SIGPIPE)) sigtimedwait(&pipe, NULL, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return err;
+}
+
+static void exec_capture(struct exec_t *res, const char *data, size_t len) {
+	// keep the tail of the output, that's where tools report errors
+	if (len >= sizeof(res->out)) {
+		data += len - (sizeof(res->out) - 1);
+		len = sizeof(res->out) - 1;
+	}
+	if (res->out_len + len >= sizeof(res->out)) {
+		size_t drop = res->out_len + len - (sizeof(res->out) - 1);
+		memmove(res->out, res->out + drop, res->out_len - drop);
+		res->out_len -= drop;
+	}
+	memcpy(res->out + res->out_len, data, len);
+	res->out_len += len;
+	res->out[res->out_len] = '\0';
+}
+
+struct exec_lines_t {
+	exec_line_fn fn;
+	void *arg;
+	size_t len;
+	char line[EXEC_LINE_SIZE];
+};
+
+static void exec_lines(struct exec_lines_t *l, const char *data, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (data[i] != '\n' && data[i] != '\r') {
+			if (l->len < sizeof(l->line) - 1) l->line[l->len++] = data[i];
+			continue;
+		}
+		if (!l->len) continue;
+		l->line[l->len] = '\0';
+		l->fn(l->line, l->arg);
+		l->len = 0;
+	}
+}
+
+int run_argv(const char *const argv[], const char *input, struct exec_t *res) {
+	return run_argv_lines(argv, input, res, NULL, NULL);
+}
+
+int run_argv_lines(const char *const argv[], const char *input, struct exec_t *res, exec_line_fn fn, void *arg) {
+	struct exec_t scratch; // not static, jobs run commands on several threads
+	if (res == NULL) res = &scratch;
+	memset(res, 0, sizeof(*res));
+	res->status = -1;
+
+	uint32_t start = now_ms();
+
+#ifndef TARGET_RETROFW
+	(void)input;
+	(void)fn;
+	(void)arg;
+	res->status = 0;
+	exec_log(argv, res);
+	return res->status;
+#endif
+
+	// close-on-exec, or a tool started by another job inherits the write
+	// ends and this read loop sees no EOF until that tool exits too
+	int out[2], in[2] = { -1, -1 };
+	if (pipe2(out, O_CLOEXEC) < 0) return -1;
+	if (input != NULL && pipe2(in, O_CLOEXEC) < 0) {
+		close(out[0]);
+		close(out[1]);
+		return -1;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDERR_FILENO);
+	posix_spawn_file_actions_addclose(&actions, out[0]);
+	posix_spawn_file_actions_addclose(&actions, out[1]);
+	if (input != NULL) {
+		posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+		posix_spawn_file_actions_addclose(&actions, in[0]);
+		posix_spawn_file_actions_addclose(&actions, in[1]);
+	}
+
+	pid_t pid;
+	int err = posix_spawnp(&pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(out[1]);
+	if (input != NULL) close(in[0]);
+
+	if (err != 0) {
+		close(out[0]);
+		if (input != NULL) close(in[1]);
+		res->ms = now_ms() - start;
+		exec_log(argv, res);
+		return -1;
+	}
+
+	if (input != NULL) {
+		// the scripted answers are far below the pipe capacity
+		res->input_err = exec_feed(in[1], input, strlen(input));
+		close(in[1]);
+	}
+
+	struct exec_lines_t lines;
+	lines.fn = fn;
+	lines.arg = arg;
+	lines.len = 0;
+
+	char chunk[256];
+	ssize_t len;
+	while ((len = read(out[0], chunk, sizeof(chunk))) != 0) {
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		exec_capture(res, chunk, len);
+		if (fn != NULL) exec_lines(&lines, chunk, len);
+	}
+	if (fn != NULL) exec_lines(&lines, "\n", 1);
+	close(out[0]);
+
+	int status;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+	res->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	res->ms = now_ms() - start;
+
+	exec_log(argv, res);
+	return res->status;
+}
+
+static int run_va(const char *pattern, const char *input, exec_line_fn fn, void *fn_arg, const char *file, va_list ap) {
+	const char *argv[EXEC_MAX_ARGS + 1];
+	int argc = 0;
+
+	argv[argc++] = file;
+	const char *arg;
+	while ((arg = va_arg(ap, const char *)) != NULL && argc < EXEC_MAX_ARGS)
+		argv[argc++] = arg;
+
+	glob_t g;
+	memset(&g, 0, sizeof(g));
+	if (pattern != NULL && glob(pattern, 0, NULL, &g) == 0) {
+		for (size_t i = 0; i < g.gl_pathc && argc < EXEC_MAX_ARGS; i++)
+			argv[argc++] = g.gl_pathv[i];
+	}
+	argv[argc] = NULL;
+
+	int ret = run_argv_lines(argv, input, NULL, fn, fn_arg);
+	globfree(&g);
+	return ret;
+}
+
+int run(const char *file, ...) {
+	va_list ap;
+	va_start(ap, file);
+	int ret = run_va(NULL, NULL, NULL, NULL, file, ap);
+	va_end(ap);
+	return ret;
+}
+
+int run_input(const char *input, const char *file, ...) {
+	va_list ap;
+	va_start(ap, file);
+	int ret = run_va(NULL, input, NULL, NULL, file, ap);
+	va_end(ap);
+	return ret;
+}
+
+int run_lines(exec_line_fn fn, void *arg, const char *file, ...) {
+	va_list ap;
+	va_start(ap, file);
+	int ret = run_va(NULL, NULL, fn, arg, file, ap);
+	va_end(ap);
+	return ret;
+}
+
+int run_glob(const char *pattern, const char *file, ...) {
+	va_list ap;
+	va_start(ap, file);
+	int ret = run_va(pattern, NULL, NULL, NULL, file, ap);
+	va_end(ap);
+	return ret;
+}
+
+const char *glob_last(const char *pattern, char *path, size_t size) {
+	glob_t g;
+	memset(&g, 0, sizeof(g));
+	path[0] = '\0';
+
+	if (glob(pattern, 0, NULL, &g) == 0 && g.gl_pathc > 0) {
+		strncpy(path, g.gl_pathv[g.gl_pathc - 1], size - 1);
+		path[size - 1] = '\0';
+	}
+	globfree(&g);
+	return path;
+}
+
+int write_file(const char *path, const char *str) {
+#ifndef TARGET_RETROFW
+	printf("write: %s < %s\n", path, str);
+	return 0;
+#endif
+
+	int fd = open(path, O_WRONLY);
+	if (fd < 0) return -1;
+	ssize_t len = write(fd, str, strlen(str));
+	close(fd);
+	return len < 0 ? -1 : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// External command executor. Tools are started directly with posix_spawnp
+// and an argv array instead of system(), so there's no intermediate shell.
+// stdout/stderr are captured into a bounded buffer (the tail is kept) and
+// every command is appended with its exit status and wall time to
+// EXEC_LOG_FILE, without a word on the console. Non-RetroFW builds only
+// print the commands.
+
+#define EXEC_LOG_FILE	"/tmp/retrofw-exec.log"
+#define EXEC_OUT_SIZE	2048
+#define EXEC_MAX_ARGS	32
+#define EXEC_LINE_SIZE	256		// longer lines are cut
+
+struct exec_t {
+	int status;			// exit status, -1 if the command could not be started
+	uint32_t ms;
+	int input_err;		// errno of writing the input, 0 if all of it was written
+	size_t out_len;
+	char out[EXEC_OUT_SIZE];
+};
+
+// Gets every line of output while the command runs; \r ends a line too,
+// that's how tools redraw their progress
+typedef void (*exec_line_fn)(const char *line, void *arg);
+
+// argv is NULL terminated; input, if not NULL, is fed to the command's stdin
+int run_argv(const char *const argv[], const char *input, struct exec_t *res);
+int run_argv_lines(const char *const argv[], const char *input, struct exec_t *res, exec_line_fn fn, void *arg);
+
+// run("tool", "arg", ..., NULL), returns the exit status
+int run(const char *file, ...);
+int run_input(const char *input, const char *file, ...);
+int run_lines(exec_line_fn fn, void *arg, const char *file, ...);
+
+// Like run(), with the paths matching pattern appended to the arguments
+int run_glob(const char *pattern, const char *file, ...);
+
+// Last path matching pattern in sort order, like $(ls pattern | tail -n 1)
+const char *glob_last(const char *pattern, char *path, size_t size);
+
+int write_file(const char *path, const char *str);
+
+// Adds a step done natively (no external command) to the log
+void exec_log_step(const char *step, int status, uint32_t ms);
+uint32_t now_ms();
+
+#endif
@@ -0,0 +1,169 @@
+#include "fb.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct fb_t fb = { -1 };
+
+static size_t fb_page_size() {
+	return (size_t)fb.pitch * fb.h;
+}
+
+static uint8_t *fb_page(int page) {
+	return fb.mem + page * fb_page_size();
+}
+
+static int fb_geometry() {
+	struct stat s;
+	if (fstat(fb.fd, &s) < 0) return -1;
+
+	if (S_ISREG(s.st_mode)) {
+		fb.fake = true;
+		fb.w = FB_FAKE_W;
+		fb.h = FB_FAKE_H;
+		fb.bpp = FB_FAKE_BPP;
+		fb.pitch = fb.w * fb.bpp / 8;
+		fb.rgb565 = fb.bpp == 16;
+		fb.pages = (size_t)s.st_size >= 2 * fb_page_size() ? 2 : 1;
+		fb.size = fb.pages * fb_page_size();
+		return (size_t)s.st_size >= fb_page_size() ? 0 : -1;
+	}
+
+	struct fb_fix_screeninfo fix;
+	if (ioctl(fb.fd, FBIOGET_VSCREENINFO, &fb.var) < 0 || ioctl(fb.fd, FBIOGET_FSCREENINFO, &fix) < 0) return -1;
+	fb.saved = fb.var;
+
+	// ask for a second page if the virtual screen has no room for one
+	if (fb.var.yres_virtual < 2 * fb.var.yres) {
+		struct fb_var_screeninfo var = fb.var;
+		var.yres_virtual = 2 * var.yres;
+		var.yoffset = 0;
+		if (ioctl(fb.fd, FBIOPUT_VSCREENINFO, &var) == 0) {
+			ioctl(fb.fd, FBIOGET_VSCREENINFO, &fb.var);
+			ioctl(fb.fd, FBIOGET_FSCREENINFO, &fix);
+		}
+	}
+
+	fb.w = fb.var.xres;
+	fb.h = fb.var.yres;
+	fb.bpp = fb.var.bits_per_pixel;
+	fb.pitch = fix.line_length;
+	fb.rgb565 = fb.bpp == 16 && fb.var.red.offset == 11 && fb.var.red.length == 5 &&
+		fb.var.green.offset == 5 && fb.var.green.length == 6 && fb.var.blue.offset == 0;
+	fb.pages = (fb.var.yres_virtual >= 2 * fb.var.yres && fix.smem_len >= 2 * fb_page_size()) ? 2 : 1;
+	fb.front = fb.var.yoffset >= fb.var.yres && fb.pages == 2 ? 1 : 0;
+	fb.size = fb.pages * fb_page_size();
+	return 0;
+}
+
+int fb_open(const char *dev) {
+	if (fb.mem != NULL) return 0;
+
+	fb.fd = open(dev, O_RDWR);
+	if (fb.fd < 0) return -1;
+
+	if (fb_geometry() < 0) {
+		fb_close();
+		return -1;
+	}
+
+	void *mem = mmap(0, fb.size, PROT_READ | PROT_WRITE, MAP_SHARED, fb.fd, 0);
+	if (mem == MAP_FAILED) {
+		fb_close();
+		return -1;
+	}
+	fb.mem = (uint8_t *)mem;
+
+	// start from what is on screen
+	if (fb.pages == 2) memcpy(fb_back(), fb_page(fb.front), fb_page_size());
+	return 0;
+}
+
+void fb_close() {
+	if (fb.mem != NULL) {
+		// leave the last frame on page 0, where the console expects it
+		if (fb.front != 0) memcpy(fb_page(0), fb_page(fb.front), fb_page_size());
+		munmap(fb.mem, fb.size);
+	}
+
+	if (fb.fd >= 0) {
+		if (!fb.fake && fb.saved.xres) {
+			fb.saved.yoffset = 0;
+			ioctl(fb.fd, FBIOPUT_VSCREENINFO, &fb.saved);
+		}
+		close(fb.fd);
+	}
+
+	memset(&fb, 0, sizeof(fb));
+	fb.fd = -1;
+}
+
+int fb_mode(const char *dev, int *w, int *h) {
+	int fd = open(dev, O_RDONLY);
+	if (fd < 0) return -1;
+
+	struct stat s;
+	struct fb_var_screeninfo var;
+	int ret = 0;
+	if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode)) {
+		*w = FB_FAKE_W;
+		*h = FB_FAKE_H;
+	} else if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == 0) {
+		*w = var.xres;
+		*h = var.yres;
+	} else {
+		ret = -1;
+	}
+	close(fd);
+	return ret;
+}
+
+void *fb_back() {
+	return fb_page(fb.pages == 2 ? !fb.front : fb.front);
+}
+
+void fb_present(const struct fb_rect_t *rects, int n) {
+	if (fb.mem == NULL || fb.pages < 2) return; // single page, drawn in place
+
+	int back = !fb.front;
+	if (!fb.fake) {
+		struct fb_var_screeninfo var = fb.var;
+		var.yoffset = back * fb.h;
+#if FB_VSYNC
+		int crtc = 0;
+		ioctl(fb.fd, FBIO_WAITFORVSYNC, &crtc);
+#endif
+		if (ioctl(fb.fd, FBIOPAN_DISPLAY, &var) < 0) {
+			// no panning, show the frame by copying it to the front page
+			memcpy(fb_page(fb.front), fb_page(back), fb_page_size());
+			return;
+		}
+	}
+	fb.front = back;
+
+	// the new back page is one frame behind, bring it up to date
+	uint8_t *src = fb_page(fb.front), *dst = (uint8_t *)fb_back();
+	if (n == 0) {
+		memcpy(dst, src, fb_page_size());
+		return;
+	}
+
+	const int bytes = fb.bpp / 8;
+	for (int i = 0; i < n; i++) {
+		struct fb_rect_t r = rects[i];
+		if (r.x < 0) { r.w += r.x; r.x = 0; }
+		if (r.y < 0) { r.h += r.y; r.y = 0; }
+		if (r.x + r.w > fb.w) r.w = fb.w - r.x;
+		if (r.y + r.h > fb.h) r.h = fb.h - r.y;
+		if (r.w <= 0 || r.h <= 0) continue;
+
+		for (int y = r.y; y < r.y + r.h; y++) {
+			size_t off = (size_t)y * fb.pitch + r.x * bytes;
+			memcpy(dst + off, src + off, r.w * bytes);
+		}
+	}
+}
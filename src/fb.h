@@ -0,0 +1,58 @@
+#ifndef FB_H
+#define FB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/fb.h>
+
+// Direct framebuffer backend. The UI draws into an off-screen page of the
+// mmap'ed framebuffer and fb_present() pans it in with FBIOPAN_DISPLAY,
+// instead of SDL copying a shadow surface on every flip. A regular file
+// works as a fake framebuffer for headless runs: the geometry then comes
+// from FB_FAKE_* and panning only switches pages.
+
+#define FB_DEV			"/dev/fb0"
+#ifndef FB_FAKE_W
+	#define FB_FAKE_W	320
+#endif
+#ifndef FB_FAKE_H
+	#define FB_FAKE_H	240
+#endif
+#define FB_FAKE_BPP		16
+
+#ifndef FB_VSYNC
+	#define FB_VSYNC	1	// wait for vertical blank before panning
+#endif
+
+struct fb_rect_t {
+	int x, y, w, h;
+};
+
+struct fb_t {
+	int fd;
+	uint8_t *mem;
+	size_t size;
+	int w, h, bpp, pitch;
+	int pages;			// 2 when there is room for a back page
+	int front;
+	bool fake;			// regular file, no ioctls
+	bool rgb565;
+	struct fb_var_screeninfo var, saved;
+};
+
+extern struct fb_t fb;
+
+int fb_open(const char *dev);
+void fb_close();
+
+// Visible mode of a framebuffer, without mapping it
+int fb_mode(const char *dev, int *w, int *h);
+
+// Page to draw into
+void *fb_back();
+
+// Shows the back page, then copies the given rectangles (everything if
+// n == 0) into the new back page so it holds the frame on screen.
+void fb_present(const struct fb_rect_t *rects, int n);
+
+#endif
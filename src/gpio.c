@@ -0,0 +1,177 @@
+#include "gpio.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#if defined(__has_include)
+	#if __has_include(<linux/gpio.h>)
+		#include <linux/gpio.h>
+	#endif
+#endif
+
+static const uint32_t port_mask[GPIO_PORTS] = {
+	gpio_port_mask(PORT_A), gpio_port_mask(PORT_B), gpio_port_mask(PORT_C),
+	gpio_port_mask(PORT_D), gpio_port_mask(PORT_E), gpio_port_mask(PORT_F),
+};
+
+static const uint32_t port_low[GPIO_PORTS] = {
+	gpio_port_low(PORT_A), gpio_port_low(PORT_B), gpio_port_low(PORT_C),
+	gpio_port_low(PORT_D), gpio_port_low(PORT_E), gpio_port_low(PORT_F),
+};
+
+struct gpio_source_t {
+	volatile uint32_t *mem;
+	int handle[GPIO_PORTS];	// gpiochip line handles
+	int lines[GPIO_PORTS];
+	uint8_t bit[GPIO_PORTS][32];
+};
+
+static int gpio_open_mem(struct gpio_source_t *src) {
+	int memdev = open(ROOT("/dev/mem"), O_RDONLY | O_SYNC);
+	if (memdev < 0) return -1;
+
+	void *mem = mmap(0, GPIO_PORTS * GPIO_PORT_SIZE, PROT_READ, MAP_SHARED, memdev, GPIO_BASE);
+	close(memdev);
+	if (mem == MAP_FAILED) return -1;
+
+	src->mem = (volatile uint32_t *)mem;
+	return 0;
+}
+
+static int gpio_open_chip(struct gpio_source_t *src) {
+#if defined(GPIOHANDLE_GET_LINE_VALUES_IOCTL)
+	char path[32];
+
+	for (int p = 0; p < GPIO_PORTS; p++) {
+		if (!port_mask[p]) continue;
+
+		struct gpiohandle_request req;
+		memset(&req, 0, sizeof(req));
+		req.flags = GPIOHANDLE_REQUEST_INPUT;
+		strcpy(req.consumer_label, "retrofw");
+
+		for (int b = 0; b < 32; b++) {
+			if (!(port_mask[p] >> b & 1)) continue;
+			src->bit[p][req.lines] = b;
+			req.lineoffsets[req.lines++] = b;
+		}
+
+		snprintf(path, sizeof(path), GPIO_CHIP, p);
+		int chip = open(ROOT(path), O_RDONLY);
+		if (chip < 0) return -1;
+		int ret = ioctl(chip, GPIO_GET_LINEHANDLE_IOCTL, &req);
+		close(chip);
+		if (ret < 0) return -1;
+
+		src->handle[p] = req.fd;
+		src->lines[p] = req.lines;
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static void gpio_close(struct gpio_source_t *src) {
+	if (src->mem != NULL) munmap((void *)src->mem, GPIO_PORTS * GPIO_PORT_SIZE);
+
+	for (int p = 0; p < GPIO_PORTS; p++) {
+		if (src->handle[p] >= 0) close(src->handle[p]);
+	}
+}
+
+// Pressed keys of every port as a bit mask, one masked read per port
+static void gpio_sample(struct gpio_source_t *src, uint32_t pressed[GPIO_PORTS]) {
+	for (int p = 0; p < GPIO_PORTS; p++) {
+		if (!port_mask[p]) continue;
+
+		uint32_t level = 0;
+		if (src->mem != NULL) {
+			level = src->mem[p * GPIO_PORT_SIZE / 4];
+		}
+#if defined(GPIOHANDLE_GET_LINE_VALUES_IOCTL)
+		else {
+			struct gpiohandle_data data;
+			if (ioctl(src->handle[p], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) == 0) {
+				for (int i = 0; i < src->lines[p]; i++)
+					level |= (uint32_t)!!data.values[i] << src->bit[p][i];
+			} else {
+				level = port_low[p]; // reads as released
+			}
+		}
+#endif
+
+		pressed[p] = (level ^ port_low[p]) & port_mask[p];
+	}
+}
+
+int gpio_read_keys(uint8_t *keys) {
+	struct gpio_source_t src;
+	memset(&src, 0, sizeof(src));
+	for (int p = 0; p < GPIO_PORTS; p++)
+		src.handle[p] = -1;
+
+	if (gpio_open_mem(&src) < 0 && gpio_open_chip(&src) < 0) {
+		gpio_close(&src);
+		return -1;
+	}
+
+	uint8_t count[GPIO_KEYS];
+	memset(count, 0, sizeof(count));
+
+	for (int s = 0; s < GPIO_SAMPLES; s++) {
+		if (s > 0) usleep(GPIO_WINDOW_MS * 1000 / (GPIO_SAMPLES - 1));
+
+		uint32_t pressed[GPIO_PORTS];
+		gpio_sample(&src, pressed);
+
+		for (unsigned int i = 0; i < GPIO_KEYS; i++)
+			count[i] += pressed[gpio_keys[i].port] >> gpio_keys[i].bit & 1;
+	}
+
+	gpio_close(&src);
+
+	for (unsigned int i = 0; i < GPIO_KEYS; i++)
+		keys[gpio_keys[i].key] = count[i] * 2 > GPIO_SAMPLES;
+
+	return 0;
+}
+
+// Source of the UI, open from gpio_open_keys() to gpio_close_keys()
+static struct gpio_source_t ui_src;
+static bool ui_open = false;
+
+int gpio_open_keys() {
+	if (ui_open) return 0;
+	memset(&ui_src, 0, sizeof(ui_src));
+	for (int p = 0; p < GPIO_PORTS; p++)
+		ui_src.handle[p] = -1;
+
+	if (gpio_open_mem(&ui_src) < 0 && gpio_open_chip(&ui_src) < 0) {
+		gpio_close(&ui_src);
+		return -1;
+	}
+	ui_open = true;
+	return 0;
+}
+
+int gpio_poll_keys(uint8_t *keys) {
+	if (!ui_open) return -1;
+
+	uint32_t pressed[GPIO_PORTS];
+	gpio_sample(&ui_src, pressed);
+	for (unsigned int i = 0; i < GPIO_KEYS; i++)
+		keys[gpio_keys[i].key] = pressed[gpio_keys[i].port] >> gpio_keys[i].bit & 1;
+	return 0;
+}
+
+void gpio_close_keys() {
+	if (!ui_open) return;
+	gpio_close(&ui_src);
+	ui_open = false;
+}
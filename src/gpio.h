@@ -0,0 +1,101 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stdint.h>
+#include "keymap.h"
+
+// Boot key combo sampler. The GPIO ports are read GPIO_SAMPLES times over
+// GPIO_WINDOW_MS and a key counts as pressed when it was seen pressed in
+// the majority of samples. Which pin is which key comes from the board
+// profile selected at compile time with -DBOARD=<name>.
+
+#define GPIO_BASE		0x10010000
+#define GPIO_PORT_SIZE	0x100
+#define GPIO_PORTS		6
+#define GPIO_CHIP		"/dev/gpiochip%d" // fallback when /dev/mem is unavailable, one chip per port
+
+#ifndef GPIO_SAMPLES
+	#define GPIO_SAMPLES	5
+#endif
+#ifndef GPIO_WINDOW_MS
+	#define GPIO_WINDOW_MS	20
+#endif
+
+enum gpio_ports {
+	PORT_A,
+	PORT_B,
+	PORT_C,
+	PORT_D,
+	PORT_E,
+	PORT_F,
+};
+
+#define GPIO_ACTIVE_LOW		0
+#define GPIO_ACTIVE_HIGH	1
+
+struct gpio_key_t {
+	uint16_t key;
+	uint8_t port;
+	uint8_t bit;
+	uint8_t active;
+};
+
+// Profiles are selected with -DBOARD=<name>, jz4760 when no board is named.
+// Every profile gets an id below, a name without one stops the build.
+#define BOARD_jz4760	1
+
+#ifndef BOARD
+	#define BOARD jz4760
+#endif
+#define BOARD_ID(name)	BOARD_ID_(name)
+#define BOARD_ID_(name)	BOARD_##name
+
+#if BOARD_ID(BOARD) == BOARD_jz4760
+#define GPIO_PROFILE "jz4760"
+static constexpr struct gpio_key_t gpio_keys[] = {
+	{ BTN_A,			PORT_D, 22, GPIO_ACTIVE_LOW },
+	{ BTN_B,			PORT_D, 23, GPIO_ACTIVE_LOW },
+	{ BTN_X,			PORT_E,  7, GPIO_ACTIVE_LOW },
+	{ BTN_Y,			PORT_E, 11, GPIO_ACTIVE_LOW },
+	{ BTN_L,			PORT_B, 23, GPIO_ACTIVE_LOW },
+	{ BTN_R,			PORT_D, 24, GPIO_ACTIVE_LOW },
+	{ BTN_SELECT,		PORT_D, 17, GPIO_ACTIVE_HIGH },
+	{ BTN_START,		PORT_D, 18, GPIO_ACTIVE_HIGH },
+	{ BTN_BACKLIGHT,	PORT_D, 21, GPIO_ACTIVE_LOW },
+	{ BTN_POWER,		PORT_A, 30, GPIO_ACTIVE_LOW },
+	{ BTN_UP,			PORT_B, 25, GPIO_ACTIVE_LOW },
+	{ BTN_DOWN,			PORT_B, 24, GPIO_ACTIVE_LOW },
+	{ BTN_LEFT,			PORT_D,  0, GPIO_ACTIVE_LOW },
+	{ BTN_RIGHT,		PORT_B, 26, GPIO_ACTIVE_LOW },
+};
+#endif
+
+#ifndef GPIO_PROFILE
+	#error "no GPIO key profile for this board"
+#endif
+
+#define GPIO_KEYS (sizeof(gpio_keys) / sizeof(gpio_keys[0]))
+
+// Bits of a port used by the profile
+constexpr uint32_t gpio_port_mask(int port, unsigned int i = 0) {
+	return i >= GPIO_KEYS ? 0 :
+		((gpio_keys[i].port == port ? 1u << gpio_keys[i].bit : 0) | gpio_port_mask(port, i + 1));
+}
+
+// Bits of a port which read 0 when the key is pressed
+constexpr uint32_t gpio_port_low(int port, unsigned int i = 0) {
+	return i >= GPIO_KEYS ? 0 :
+		((gpio_keys[i].port == port && gpio_keys[i].active == GPIO_ACTIVE_LOW ? 1u << gpio_keys[i].bit : 0) | gpio_port_low(port, i + 1));
+}
+
+// Sets keys[] for every key of the board profile, returns -1 when no GPIO
+// source is available
+int gpio_read_keys(uint8_t *keys);
+
+// The UI keeps the source open and takes a single sample per poll, the
+// debounce window is for the boot combo only
+int gpio_open_keys();
+int gpio_poll_keys(uint8_t *keys);
+void gpio_close_keys();
+
+#endif
@@ -0,0 +1,128 @@
+#include "intent.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *intent_names[] = {
+	"none",
+	"resize",
+	"defl",
+	"fsck",
+};
+
+const char *intent_name(int op) {
+	if (op < 0 || op > OP_FSCK) return "unknown";
+	return intent_names[op];
+}
+
+static uint32_t crc32(const void *data, size_t len) {
+	const uint8_t *p = (const uint8_t *)data;
+	uint32_t crc = 0xffffffff;
+
+	while (len--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+static void intent_reset(struct intent_journal_t *j) {
+	memset(j, 0, sizeof(*j));
+	j->magic = INTENT_MAGIC;
+	j->version = INTENT_VERSION;
+}
+
+int intent_load(struct intent_journal_t *j) {
+	intent_reset(j);
+
+	int fd = open(ROOT(INTENT_FILE), O_RDONLY);
+	if (fd < 0) return -1;
+
+	struct intent_journal_t tmp;
+	ssize_t len = read(fd, &tmp, sizeof(tmp));
+	close(fd);
+
+	if (len != sizeof(tmp) || tmp.magic != INTENT_MAGIC || tmp.version != INTENT_VERSION ||
+		tmp.count > INTENT_MAX || tmp.crc != crc32(&tmp, offsetof(struct intent_journal_t, crc))) {
+		return -1;
+	}
+
+	*j = tmp;
+	return 0;
+}
+
+int intent_save(struct intent_journal_t *j) {
+	// drop the queue once everything in it has completed
+	if (intent_next(j) == NULL) j->count = 0;
+
+	memset(&j->ops[j->count], 0, sizeof(j->ops[0]) * (INTENT_MAX - j->count));
+	j->crc = crc32(j, offsetof(struct intent_journal_t, crc));
+
+	int fd = open(ROOT(INTENT_FILE ".tmp"), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return -1;
+
+	ssize_t len = write(fd, j, sizeof(*j));
+	fsync(fd);
+	close(fd);
+
+	if (len != sizeof(*j)) return -1;
+	return rename(ROOT(INTENT_FILE ".tmp"), ROOT(INTENT_FILE));
+}
+
+void intent_import_legacy(struct intent_journal_t *j) {
+	struct stat s;
+	bool prsz = !stat(ROOT("/boot/.prsz"), &s);
+	bool defl = !stat(ROOT("/boot/.defl"), &s);
+	bool fsck = !stat(ROOT("/boot/.fsck"), &s);
+
+	intent_reset(j);
+
+	// same order the markers were handled in, one reboot apart
+	if (prsz) intent_add(j, OP_RESIZE, 0);
+	if (defl) intent_add(j, OP_DEFL, 0);
+	if (defl || fsck) intent_add(j, OP_FSCK, fsck ? 0 : FSCK_EXTERNAL); // the external card is only checked after first boot
+
+	if (intent_save(j) == 0) {
+		unlink(ROOT("/boot/.prsz"));
+		unlink(ROOT("/boot/.defl"));
+		unlink(ROOT("/boot/.fsck"));
+	}
+}
+
+int intent_add(struct intent_journal_t *j, int op, uint32_t param) {
+	if (intent_next(j) == NULL) j->count = 0;
+	if (j->count >= INTENT_MAX) return -1;
+
+	struct intent_op_t *o = &j->ops[j->count++];
+	o->op = op;
+	o->state = INTENT_PENDING;
+	o->reserved = 0;
+	o->param = param;
+	return 0;
+}
+
+void intent_report(struct intent_journal_t *j) {
+	if (intent_next(j) == NULL) {
+		printf("No pending operations\n");
+		return;
+	}
+
+	static const char *states[] = { "pending", "running", "done" };
+	for (int i = 0; i < j->count; i++) {
+		printf("%d: %-8s %-8s param=%u\n", i, intent_name(j->ops[i].op),
+			j->ops[i].state <= INTENT_DONE ? states[j->ops[i].state] : "?", j->ops[i].param);
+	}
+}
+
+struct intent_op_t *intent_next(struct intent_journal_t *j) {
+	for (int i = 0; i < j->count; i++) {
+		if (j->ops[i].state != INTENT_DONE) return &j->ops[i];
+	}
+	return NULL;
+}
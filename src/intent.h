@@ -0,0 +1,59 @@
+#ifndef INTENT_H
+#define INTENT_H
+
+#include <stdint.h>
+
+// Boot-intent journal: an ordered queue of maintenance operations that the
+// next recovery session has to run, stored as one checksummed record so a
+// normal boot costs a single open/read. Replaces the /boot/.prsz, .defl and
+// .fsck marker files, which are imported once when no journal exists yet.
+
+#define INTENT_FILE		"/boot/.intent"
+#define INTENT_MAGIC	0x544e4952 // "RINT"
+#define INTENT_VERSION	1
+#define INTENT_MAX		8
+
+enum intent_ops {
+	OP_NONE,
+	OP_RESIZE,	// grow the data partition to the end of the card
+	OP_DEFL,	// restore default data (format mmcblk0p3 and swap)
+	OP_FSCK,	// check the internal card, param FSCK_EXTERNAL adds mmcblk1
+};
+
+enum intent_states {
+	INTENT_PENDING,
+	INTENT_RUNNING,
+	INTENT_DONE,
+};
+
+#define FSCK_EXTERNAL	(1 << 0)
+
+struct intent_op_t {
+	uint8_t op;
+	uint8_t state;
+	uint16_t reserved;
+	uint32_t param;
+};
+
+struct intent_journal_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	struct intent_op_t ops[INTENT_MAX];
+	uint32_t crc;
+};
+
+const char *intent_name(int op);
+
+// Returns 0 on success, -1 if the journal is missing or corrupt
+int intent_load(struct intent_journal_t *j);
+int intent_save(struct intent_journal_t *j);
+
+// Builds the journal from the legacy marker files and removes them
+void intent_import_legacy(struct intent_journal_t *j);
+
+int intent_add(struct intent_journal_t *j, int op, uint32_t param);
+struct intent_op_t *intent_next(struct intent_journal_t *j);
+void intent_report(struct intent_journal_t *j);
+
+#endif
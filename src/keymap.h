@@ -0,0 +1,21 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <SDL/SDL.h>
+
+#define BTN_X			SDLK_SPACE
+#define BTN_A			SDLK_LCTRL
+#define BTN_B			SDLK_LALT
+#define BTN_Y			SDLK_LSHIFT
+#define BTN_L			SDLK_TAB
+#define BTN_R			SDLK_BACKSPACE
+#define BTN_START		SDLK_RETURN
+#define BTN_SELECT		SDLK_ESCAPE
+#define BTN_BACKLIGHT	SDLK_3
+#define BTN_POWER		SDLK_END
+#define BTN_UP			SDLK_UP
+#define BTN_DOWN		SDLK_DOWN
+#define BTN_LEFT		SDLK_LEFT
+#define BTN_RIGHT		SDLK_RIGHT
+
+#endif
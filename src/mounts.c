@@ -0,0 +1,381 @@
+#include "mounts.h"
+#include "exec.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <mntent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/swap.h>
+#include <sys/sysmacros.h>
+
+#define MNT_MAX_DEVS	16
+
+struct mnt_devs_t {
+	int count;
+	dev_t dev[MNT_MAX_DEVS];
+};
+
+static bool mnt_has_dev(const struct mnt_devs_t *devs, dev_t dev) {
+	for (int i = 0; i < devs->count; i++) {
+		if (devs->dev[i] == dev) return true;
+	}
+	return false;
+}
+
+// mountinfo escapes blanks in paths as octal, e.g. \040
+static void mnt_unescape(char *s) {
+	char *d = s;
+	while (*s) {
+		if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' && s[2] && s[3]) {
+			*d++ = (s[1] - '0') << 6 | (s[2] - '0') << 3 | (s[3] - '0');
+			s += 4;
+		} else {
+			*d++ = *s++;
+		}
+	}
+	*d = '\0';
+}
+
+int mnt_read(struct mnt_entry_t *mnt, int max) {
+	FILE *f = fopen("/proc/self/mountinfo", "r");
+	if (f == NULL) return 0;
+
+	char line[512];
+	int count = 0;
+	while (count < max && fgets(line, sizeof(line), f)) {
+		struct mnt_entry_t *m = &mnt[count];
+		unsigned int major, minor;
+
+		// id parent major:minor root target options [optional...] - fstype source super
+		if (sscanf(line, "%d %d %u:%u %*s %127s", &m->id, &m->parent, &major, &minor, m->target) != 5) continue;
+
+		char *sep = strstr(line, " - ");
+		if (sep == NULL || sscanf(sep + 3, "%15s %63s", m->fstype, m->source) != 2) continue;
+
+		mnt_unescape(m->target);
+		m->dev = makedev(major, minor);
+		count++;
+	}
+	fclose(f);
+	return count;
+}
+
+static void mnt_swapoff(const struct mnt_devs_t *devs) {
+	FILE *f = fopen("/proc/swaps", "r");
+	if (f == NULL) return;
+
+	char line[256], name[128];
+	fgets(line, sizeof(line), f); // header
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%127s", name) != 1) continue;
+		mnt_unescape(name);
+
+		struct stat s;
+		if (stat(name, &s) != 0) continue;
+		if (!(S_ISBLK(s.st_mode) && mnt_has_dev(devs, s.st_rdev)) && !mnt_has_dev(devs, s.st_dev)) continue;
+
+		uint32_t start = now_ms();
+		int ret = swapoff(name);
+		snprintf(line, sizeof(line), "swapoff %s", name);
+		exec_log_step(line, ret ? errno : 0, now_ms() - start);
+	}
+	fclose(f);
+}
+
+static bool mnt_uses(const char *path, dev_t dev) {
+	struct stat s;
+	return stat(path, &s) == 0 && s.st_dev == dev;
+}
+
+// Processes with an open file, cwd, root or mapping on the filesystem
+static int mnt_holders(const struct mnt_entry_t *m, bool kill_holders, int sig) {
+	DIR *proc = opendir("/proc");
+	if (proc == NULL) return 0;
+
+	char path[300], link[256], line[512];
+	int found = 0;
+	pid_t self = getpid();
+
+	struct dirent *p;
+	while ((p = readdir(proc)) != NULL) {
+		pid_t pid = atoi(p->d_name);
+		if (pid <= 1 || pid == self) continue;
+
+		bool holds = false;
+		const char *what = "";
+
+		snprintf(path, sizeof(path), "/proc/%d/cwd", pid);
+		if (mnt_uses(path, m->dev)) { holds = true; what = "cwd"; }
+		snprintf(path, sizeof(path), "/proc/%d/root", pid);
+		if (!holds && mnt_uses(path, m->dev)) { holds = true; what = "root"; }
+
+		snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+		DIR *fds = holds ? NULL : opendir(path);
+		if (fds != NULL) {
+			struct dirent *fd;
+			while (!holds && (fd = readdir(fds)) != NULL) {
+				if (fd->d_name[0] == '.') continue;
+				snprintf(path, sizeof(path), "/proc/%d/fd/%s", pid, fd->d_name);
+				if (mnt_uses(path, m->dev)) { holds = true; what = "fd"; }
+			}
+			closedir(fds);
+		}
+
+		if (!holds) {
+			snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+			FILE *f = fopen(path, "r");
+			if (f != NULL) {
+				unsigned int major, minor;
+				while (!holds && fgets(line, sizeof(line), f)) {
+					if (sscanf(line, "%*s %*s %*s %x:%x", &major, &minor) == 2 && makedev(major, minor) == m->dev) {
+						holds = true;
+						what = "map";
+					}
+				}
+				fclose(f);
+			}
+		}
+
+		if (!holds) continue;
+		found++;
+
+		snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+		link[0] = '\0';
+		FILE *f = fopen(path, "r");
+		if (f != NULL) {
+			if (fgets(link, sizeof(link), f)) link[strcspn(link, "\n")] = '\0';
+			fclose(f);
+		}
+
+		snprintf(line, sizeof(line), "%s %s held by %d (%s, %s)", kill_holders ? "kill" : "busy", m->target, pid, link, what);
+		exec_log_step(line, 0, 0);
+		if (kill_holders) kill(pid, sig);
+	}
+
+	closedir(proc);
+	return found;
+}
+
+static int mnt_umount(const struct mnt_entry_t *m, bool kill_holders) {
+	char step[160];
+	uint32_t start = now_ms();
+
+	int ret = umount2(m->target, 0);
+	if (ret != 0 && errno == EBUSY) {
+		if (mnt_holders(m, kill_holders, SIGTERM) && kill_holders) {
+			usleep(MNT_KILL_WAIT_MS * 1000);
+			ret = umount2(m->target, 0);
+			if (ret != 0 && mnt_holders(m, true, SIGKILL)) {
+				usleep(MNT_KILL_WAIT_MS * 1000);
+				ret = umount2(m->target, 0);
+			}
+		}
+	}
+
+	if (ret == 0) {
+		snprintf(step, sizeof(step), "umount %s", m->target);
+		exec_log_step(step, 0, now_ms() - start);
+		return 0;
+	}
+
+	// last resort, the same as the old 'umount -fl'
+	int err = errno;
+	ret = umount2(m->target, MNT_DETACH);
+	snprintf(step, sizeof(step), "umount %s failed (%s), %s", m->target, strerror(err), ret ? "still mounted" : "detached");
+	exec_log_step(step, err, now_ms() - start);
+	return 1;
+}
+
+int mnt_release(const char *pattern, bool kill_holders) {
+	struct mnt_devs_t devs;
+	devs.count = 0;
+
+	glob_t g;
+	memset(&g, 0, sizeof(g));
+	if (glob(pattern, 0, NULL, &g) == 0) {
+		for (size_t i = 0; i < g.gl_pathc && devs.count < MNT_MAX_DEVS; i++) {
+			struct stat s;
+			if (stat(g.gl_pathv[i], &s) == 0 && S_ISBLK(s.st_mode))
+				devs.dev[devs.count++] = s.st_rdev;
+		}
+	}
+	globfree(&g);
+
+#ifndef TARGET_RETROFW
+	printf("release: %s (%d devices)\n", pattern, devs.count);
+	return 0;
+#endif
+
+	if (!devs.count) return 0;
+
+	mnt_swapoff(&devs);
+
+	struct mnt_entry_t mnt[MNT_MAX];
+	int count = mnt_read(mnt, MNT_MAX);
+
+	// mounts on the devices plus everything mounted below them
+	bool release[MNT_MAX] = { false };
+	for (int i = 0; i < count; i++) {
+		if (!strcmp(mnt[i].target, "/")) continue;
+		if (mnt_has_dev(&devs, mnt[i].dev)) release[i] = true;
+		for (int j = 0; j < i && !release[i]; j++) {
+			if (release[j] && mnt[j].id == mnt[i].parent) release[i] = true;
+		}
+	}
+
+	// reverse mount order unmounts children before their parents
+	int failed = 0;
+	for (int i = count - 1; i >= 0; i--) {
+		if (release[i]) failed += mnt_umount(&mnt[i], kill_holders);
+	}
+
+	return failed;
+}
+
+// Options only mount(8) understands, never passed to the kernel
+static bool mnt_userspace_opt(const char *opt) {
+	static const char *opts[] = { "noauto", "nofail", "user", "nouser", "users", "owner", "group", "_netdev" };
+	for (unsigned int i = 0; i < sizeof(opts) / sizeof(opts[0]); i++)
+		if (!strcmp(opt, opts[i])) return true;
+	return !strncmp(opt, "x-", 2) || !strncmp(opt, "comment=", 8);
+}
+
+// Mount flags and filesystem data of the options. native is cleared for
+// options which need mount(8), like loop.
+static unsigned long mnt_flags(const char *opts, char *data, size_t size, bool *native) {
+	static const struct { const char *name; unsigned long set, clear; } flags[] = {
+		{ "defaults", 0, 0 },
+		{ "auto", 0, 0 },
+		{ "ro", MS_RDONLY, 0 },
+		{ "rw", 0, MS_RDONLY },
+		{ "nosuid", MS_NOSUID, 0 },
+		{ "suid", 0, MS_NOSUID },
+		{ "nodev", MS_NODEV, 0 },
+		{ "dev", 0, MS_NODEV },
+		{ "noexec", MS_NOEXEC, 0 },
+		{ "exec", 0, MS_NOEXEC },
+		{ "sync", MS_SYNCHRONOUS, 0 },
+		{ "async", 0, MS_SYNCHRONOUS },
+		{ "noatime", MS_NOATIME, 0 },
+		{ "nodiratime", MS_NODIRATIME, 0 },
+		{ "relatime", MS_RELATIME, 0 },
+		{ "bind", MS_BIND, 0 },
+	};
+
+	unsigned long mountflags = 0;
+	char buf[256], *save = NULL;
+	strncpy(buf, opts, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	data[0] = '\0';
+
+	for (char *opt = strtok_r(buf, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+		bool known = false;
+		for (unsigned int i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+			if (strcmp(opt, flags[i].name)) continue;
+			mountflags = (mountflags | flags[i].set) & ~flags[i].clear;
+			known = true;
+		}
+		if (!strcmp(opt, "loop") || !strncmp(opt, "loop=", 5)) *native = false;
+		if (mnt_userspace_opt(opt)) known = true;
+		// everything else is passed to the filesystem
+		if (!known && strlen(data) + strlen(opt) + 2 < size) {
+			if (data[0]) strcat(data, ",");
+			strcat(data, opt);
+		}
+	}
+
+	return mountflags;
+}
+
+// Device of an fstab source, UUID= and LABEL= through the udev links like
+// mount(8). False if the link is missing.
+static bool mnt_source(const char *fsname, char *dev, size_t size) {
+	static const struct { const char *tag, *dir; } tags[] = {
+		{ "UUID=", "/dev/disk/by-uuid/" },
+		{ "LABEL=", "/dev/disk/by-label/" },
+		{ "PARTUUID=", "/dev/disk/by-partuuid/" },
+		{ "PARTLABEL=", "/dev/disk/by-partlabel/" },
+	};
+
+	for (unsigned int i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+		size_t len = strlen(tags[i].tag);
+		if (strncmp(fsname, tags[i].tag, len)) continue;
+
+		// the value may be quoted
+		char link[160];
+		const char *value = fsname + len;
+		int n = strlen(value);
+		if (n >= 2 && value[0] == '"' && value[n - 1] == '"') snprintf(link, sizeof(link), "%s%.*s", tags[i].dir, n - 2, value + 1);
+		else snprintf(link, sizeof(link), "%s%s", tags[i].dir, value);
+
+		char *path = realpath(link, NULL);
+		if (path == NULL) {
+			snprintf(dev, size, "%s", fsname);
+			return false;
+		}
+		snprintf(dev, size, "%s", path);
+		free(path);
+		return true;
+	}
+
+	snprintf(dev, size, "%s", fsname);
+	return true;
+}
+
+int mnt_mount_all() {
+	return mnt_mount(NULL);
+}
+
+int mnt_mount(const char *pattern) {
+	struct mnt_entry_t mnt[MNT_MAX];
+	int count = mnt_read(mnt, MNT_MAX);
+
+	FILE *fstab = setmntent("/etc/fstab", "r");
+	if (fstab == NULL) return -1;
+
+	int failed = 0;
+	struct mntent entry, *e;
+	char strings[512];
+	while ((e = getmntent_r(fstab, &entry, strings, sizeof(strings))) != NULL) {
+		if (!strcmp(e->mnt_type, "swap") || hasmntopt(e, "noauto")) continue;
+
+		char dev[160];
+		bool native = mnt_source(e->mnt_fsname, dev, sizeof(dev)) && strcmp(e->mnt_type, "auto");
+		if (pattern != NULL && fnmatch(pattern, dev, 0)) continue;
+
+		bool mounted = false;
+		for (int i = 0; i < count && !mounted; i++)
+			mounted = !strcmp(mnt[i].target, e->mnt_dir);
+		if (mounted) continue;
+
+		char data[256], step[256];
+		unsigned long flags = mnt_flags(e->mnt_opts, data, sizeof(data), &native);
+		bool nofail = hasmntopt(e, "nofail") != NULL;
+
+		// type probing, loop devices and unresolved sources are left to mount(8)
+		if (!native) {
+			if (run("mount", e->mnt_dir, NULL) && !nofail) failed++;
+			continue;
+		}
+
+		uint32_t start = now_ms();
+#ifdef TARGET_RETROFW
+		int ret = mount(dev, e->mnt_dir, e->mnt_type, flags, data[0] ? data : NULL);
+#else
+		int ret = 0;
+#endif
+		snprintf(step, sizeof(step), "mount %s %s", dev, e->mnt_dir);
+		exec_log_step(step, ret ? errno : 0, now_ms() - start);
+		if (ret && !nofail) failed++;
+	}
+
+	endmntent(fstab);
+	return failed;
+}
@@ -0,0 +1,39 @@
+#ifndef MOUNTS_H
+#define MOUNTS_H
+
+#include <sys/types.h>
+
+// Native mount table handling instead of 'umount -fl', 'swapoff -a' and
+// 'mount -a'. Devices are selected with a glob pattern as the shell calls
+// did (e.g. "/dev/mmcblk1*"). Every step is reported with its timing in
+// the executor log.
+
+#define MNT_MAX			64
+#define MNT_KILL_WAIT_MS	500
+
+struct mnt_entry_t {
+	int id;
+	int parent;
+	dev_t dev;
+	char target[128];
+	char fstype[16];
+	char source[64];
+};
+
+// Mount table from /proc/self/mountinfo, in mount order
+int mnt_read(struct mnt_entry_t *mnt, int max);
+
+// Turns off swap on and unmounts every filesystem backed by the devices
+// matching pattern, submounts first. Processes holding a busy mount are
+// reported and, if kill_holders is set, terminated. Returns the number of
+// mounts which could only be detached lazily or not at all.
+int mnt_release(const char *pattern, bool kill_holders);
+
+// Mounts every /etc/fstab entry which isn't mounted yet, like 'mount -a'
+int mnt_mount_all();
+
+// Same for the entries of the devices matching pattern only, so a job on
+// one card doesn't mount the other while a job works on it
+int mnt_mount(const char *pattern);
+
+#endif
@@ -0,0 +1,87 @@
+// Host tool: decodes the embedded background PNG and writes it as run
+// length encoded RGB565 (see src/rle565.h), so the device needs neither
+// SDL_image nor a per-frame format conversion.
+//
+// usage: png2rle565 <name> > header.h
+
+#include <stdint.h>
+#include "background.h"
+#include "rle565.h"
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+struct png_src_t {
+	const uint8_t *data;
+	size_t size, pos;
+};
+
+static void png_read(png_structp png, png_bytep out, png_size_t len) {
+	struct png_src_t *src = (struct png_src_t *)png_get_io_ptr(png);
+	if (src->pos + len > src->size) png_error(png, "truncated");
+	memcpy(out, src->data + src->pos, len);
+	src->pos += len;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <name>\n", argv[0]);
+		return 1;
+	}
+	const char *name = argv[1];
+
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png_create_info_struct(png);
+	if (setjmp(png_jmpbuf(png))) {
+		fprintf(stderr, "%s: bad png\n", name);
+		return 1;
+	}
+
+	struct png_src_t src = { background, sizeof(background), 0 };
+	png_set_read_fn(png, &src, png_read);
+	png_read_info(png, info);
+
+	// everything as 8 bit RGBA
+	png_set_expand(png);
+	png_set_strip_16(png);
+	png_set_gray_to_rgb(png);
+	png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+	png_read_update_info(png, info);
+
+	uint32_t w = png_get_image_width(png, info), h = png_get_image_height(png, info);
+	std::vector<uint8_t> rgba(w * h * 4);
+	std::vector<png_bytep> rows(h);
+	for (uint32_t y = 0; y < h; y++)
+		rows[y] = &rgba[y * w * 4];
+	png_read_image(png, &rows[0]);
+	png_destroy_read_struct(&png, &info, NULL);
+
+	// alpha, if any, is composited over black
+	std::vector<uint16_t> px(w * h);
+	for (uint32_t i = 0; i < w * h; i++) {
+		const uint8_t *p = &rgba[i * 4];
+		uint32_t r = p[0] * p[3] / 255, g = p[1] * p[3] / 255, b = p[2] * p[3] / 255;
+		px[i] = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+	}
+
+	std::vector<uint16_t> rle(2 * px.size());
+	rle.resize(rle565_encode(&px[0], w, h, w * 2, &rle[0]));
+
+	printf("// generated from src/background.h by src/png2rle565.c, do not edit\n\n#include <stdint.h>\n\n");
+	char upper[64];
+	snprintf(upper, sizeof(upper), "%s", name);
+	for (char *c = upper; *c; c++)
+		if (*c >= 'a' && *c <= 'z') *c -= 'a' - 'A';
+
+	printf("#define %s_W %u\n#define %s_H %u\n\n", upper, w, upper, h);
+	printf("const uint16_t %s[%u] = {", name, (unsigned int)rle.size());
+	for (size_t i = 0; i < rle.size(); i++)
+		printf("%s0x%04x,", i % 12 ? " " : "\n\t", rle[i]);
+	printf("\n};\n");
+
+	fprintf(stderr, "%s: %ux%u, %u bytes as RLE565 (%u raw)\n", name, w, h,
+		(unsigned int)rle.size() * 2, (unsigned int)px.size() * 2);
+	return 0;
+}
@@ -0,0 +1,370 @@
+#include "prefetch.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define PREFETCH_MAX_PIDS	64
+#define PREFETCH_WALK_DEPTH	4
+#define PREFETCH_WALK_ROOT	"/home/retrofw/apps/" // launchers whose directory is scanned too
+
+struct prefetch_files_t {
+	int count;
+	char path[PREFETCH_MAX_FILES][256];
+};
+
+static int prefetch_header(struct prefetch_header_t *hdr, const char *launcher) {
+	struct stat s;
+	if (stat(launcher, &s) != 0) return -1;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = PREFETCH_MAGIC;
+	hdr->version = PREFETCH_VERSION;
+	hdr->page_size = sysconf(_SC_PAGESIZE);
+	hdr->launcher_mtime = s.st_mtime;
+	hdr->launcher_size = s.st_size;
+	strncpy(hdr->launcher, launcher, sizeof(hdr->launcher) - 1);
+	return 0;
+}
+
+static void prefetch_replay(FILE *f, const struct prefetch_header_t *hdr) {
+	int stale = 0;
+	char path[256];
+
+	for (int i = 0; i < hdr->files; i++) {
+		uint16_t len, ranges;
+		uint32_t mtime, size;
+
+		if (fread(&len, sizeof(len), 1, f) != 1 || len >= sizeof(path) ||
+			fread(path, len, 1, f) != 1 ||
+			fread(&mtime, sizeof(mtime), 1, f) != 1 ||
+			fread(&size, sizeof(size), 1, f) != 1 ||
+			fread(&ranges, sizeof(ranges), 1, f) != 1) {
+			stale = hdr->files;
+			break;
+		}
+		path[len] = '\0';
+
+		struct stat s;
+		int fd = -1;
+		if (stat(path, &s) != 0 || (uint32_t)s.st_mtime != mtime || (uint32_t)s.st_size != size) {
+			stale++;
+		} else {
+			fd = open(path, O_RDONLY);
+		}
+
+		for (int r = 0; r < ranges; r++) {
+			uint32_t range[2];
+			if (fread(range, sizeof(range), 1, f) != 1) {
+				stale = hdr->files;
+				break;
+			}
+			if (fd >= 0) readahead(fd, (off64_t)range[0] * hdr->page_size, (size_t)range[1] * hdr->page_size);
+		}
+
+		if (fd >= 0) close(fd);
+	}
+
+	// record a fresh list on the next boot once too much of it changed
+	if (stale > hdr->files / 4) unlink(ROOT(PREFETCH_FILE));
+}
+
+static void prefetch_add(struct prefetch_files_t *files, const char *path) {
+	if (path[0] != '/' || !strncmp(path, "/proc/", 6) || !strncmp(path, "/sys/", 5) ||
+		!strncmp(path, "/dev/", 5) || !strcmp(path, ROOT(PREFETCH_FILE))) {
+		return;
+	}
+
+	for (int i = 0; i < files->count; i++) {
+		if (!strcmp(files->path[i], path)) return;
+	}
+
+	if (files->count >= PREFETCH_MAX_FILES || strlen(path) >= sizeof(files->path[0])) return;
+
+	struct stat s;
+	if (stat(path, &s) != 0 || !S_ISREG(s.st_mode)) return;
+
+	strcpy(files->path[files->count++], path);
+}
+
+static void prefetch_sample_pid(struct prefetch_files_t *files, pid_t pid) {
+	char path[300], line[512];
+
+	snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	FILE *f = fopen(path, "r");
+	if (f != NULL) {
+		while (fgets(line, sizeof(line), f)) {
+			char *p = strchr(line, '/');
+			if (p == NULL) continue;
+			p[strcspn(p, "\n")] = '\0';
+			if (strstr(p, " (deleted)")) continue;
+			prefetch_add(files, p);
+		}
+		fclose(f);
+	}
+
+	snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+	DIR *dir = opendir(path);
+	if (dir == NULL) return;
+
+	struct dirent *d;
+	while ((d = readdir(dir)) != NULL) {
+		if (d->d_name[0] == '.') continue;
+
+		// only files opened read-only, logs and configs being written change every boot
+		snprintf(path, sizeof(path), "/proc/%d/fdinfo/%s", pid, d->d_name);
+		FILE *info = fopen(path, "r");
+		unsigned int flags = O_WRONLY;
+		if (info != NULL) {
+			while (fgets(line, sizeof(line), info) && sscanf(line, "flags: %o", &flags) != 1);
+			fclose(info);
+		}
+		if ((flags & O_ACCMODE) != O_RDONLY) continue;
+
+		snprintf(path, sizeof(path), "/proc/%d/fd/%s", pid, d->d_name);
+		ssize_t len = readlink(path, line, sizeof(line) - 1);
+		if (len <= 0) continue;
+		line[len] = '\0';
+		prefetch_add(files, line);
+	}
+	closedir(dir);
+}
+
+// Adds the descendants of the pids already in the list
+static int prefetch_children(pid_t *pids, int count) {
+	DIR *dir = opendir("/proc");
+	if (dir == NULL) return count;
+
+	struct dirent *d;
+	char path[64], line[512];
+	while ((d = readdir(dir)) != NULL && count < PREFETCH_MAX_PIDS) {
+		pid_t pid = atoi(d->d_name);
+		if (pid <= 0) continue;
+
+		snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+		FILE *f = fopen(path, "r");
+		if (f == NULL) continue;
+		size_t len = fread(line, 1, sizeof(line) - 1, f);
+		fclose(f);
+		line[len] = '\0';
+
+		// pid (comm) state ppid ...
+		char *p = strrchr(line, ')');
+		pid_t ppid;
+		if (p == NULL || sscanf(p + 1, " %*c %d", &ppid) != 1) continue;
+
+		bool known = false, parent = false;
+		for (int i = 0; i < count; i++) {
+			if (pids[i] == pid) known = true;
+			if (pids[i] == ppid) parent = true;
+		}
+		if (parent && !known) pids[count++] = pid;
+	}
+	closedir(dir);
+	return count;
+}
+
+static void prefetch_walk(struct prefetch_files_t *files, const char *path, int depth) {
+	DIR *dir = opendir(path);
+	if (dir == NULL) return;
+
+	struct dirent *d;
+	char sub[512];
+	while ((d = readdir(dir)) != NULL && files->count < PREFETCH_MAX_FILES) {
+		if (d->d_name[0] == '.') continue;
+		snprintf(sub, sizeof(sub), "%s/%s", path, d->d_name);
+
+		struct stat s;
+		if (lstat(sub, &s) != 0) continue;
+		if (S_ISDIR(s.st_mode) && depth > 0) prefetch_walk(files, sub, depth - 1);
+		else if (S_ISREG(s.st_mode)) prefetch_add(files, sub);
+	}
+	closedir(dir);
+}
+
+// Writes the resident page ranges of path, returns the number of ranges
+static int prefetch_write_file(FILE *f, const char *path, long page_size) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 0;
+
+	struct stat s;
+	if (fstat(fd, &s) != 0 || s.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	size_t pages = (s.st_size + page_size - 1) / page_size;
+	void *map = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return 0;
+
+	unsigned char *vec = (unsigned char *)malloc(pages);
+	if (vec == NULL || mincore(map, s.st_size, vec) != 0) {
+		free(vec);
+		munmap(map, s.st_size);
+		return 0;
+	}
+	munmap(map, s.st_size);
+
+	uint16_t ranges = 0;
+	for (size_t i = 0; i < pages; i++) {
+		if ((vec[i] & 1) && (i == 0 || !(vec[i - 1] & 1))) ranges++;
+	}
+
+	if (ranges) {
+		uint16_t len = strlen(path);
+		uint32_t mtime = s.st_mtime, size = s.st_size;
+		fwrite(&len, sizeof(len), 1, f);
+		fwrite(path, len, 1, f);
+		fwrite(&mtime, sizeof(mtime), 1, f);
+		fwrite(&size, sizeof(size), 1, f);
+		fwrite(&ranges, sizeof(ranges), 1, f);
+
+		for (size_t i = 0; i < pages; i++) {
+			if (!(vec[i] & 1)) continue;
+			uint32_t range[2] = { (uint32_t)i, 0 };
+			while (i < pages && (vec[i] & 1)) {
+				range[1]++;
+				i++;
+			}
+			fwrite(range, sizeof(range), 1, f);
+		}
+	}
+
+	free(vec);
+	return ranges;
+}
+
+static void prefetch_record(pid_t launcher_pid, const struct prefetch_header_t *hdr) {
+	struct prefetch_files_t *files = (struct prefetch_files_t *)calloc(1, sizeof(struct prefetch_files_t));
+	if (files == NULL) return;
+
+	pid_t pids[PREFETCH_MAX_PIDS] = { launcher_pid };
+	int npids = 1;
+
+	for (int t = 0; t < PREFETCH_WINDOW_MS; t += PREFETCH_SAMPLE_MS) {
+		usleep(PREFETCH_SAMPLE_MS * 1000);
+		npids = prefetch_children(pids, npids);
+		for (int i = 0; i < npids; i++)
+			prefetch_sample_pid(files, pids[i]);
+	}
+
+	// data files read and closed again in between samples, e.g. skins
+	char dir[sizeof(hdr->launcher)];
+	strcpy(dir, hdr->launcher);
+	if (!strncmp(dir, PREFETCH_WALK_ROOT, strlen(PREFETCH_WALK_ROOT)))
+		prefetch_walk(files, dirname(dir), PREFETCH_WALK_DEPTH);
+
+	FILE *f = fopen(ROOT(PREFETCH_FILE ".tmp"), "w");
+	if (f == NULL) {
+		free(files);
+		return;
+	}
+
+	struct prefetch_header_t out = *hdr;
+	out.files = 0;
+	fwrite(&out, sizeof(out), 1, f);
+	for (int i = 0; i < files->count; i++) {
+		if (prefetch_write_file(f, files->path[i], hdr->page_size)) out.files++;
+	}
+	fseek(f, 0, SEEK_SET);
+	fwrite(&out, sizeof(out), 1, f);
+	fclose(f);
+
+	// nothing seen, e.g. the launcher came up too late: record again next boot
+	if (out.files == 0) {
+		unlink(ROOT(PREFETCH_FILE ".tmp"));
+		free(files);
+		return;
+	}
+
+	rename(ROOT(PREFETCH_FILE ".tmp"), ROOT(PREFETCH_FILE));
+	free(files);
+}
+
+void prefetch_start(const char *launcher) {
+	struct prefetch_header_t hdr;
+	if (prefetch_header(&hdr, launcher) != 0) return;
+
+	pid_t launcher_pid = getpid();
+	pid_t pid = fork();
+	if (pid < 0) return;
+
+	if (pid > 0) {
+		waitpid(pid, NULL, 0);
+		return;
+	}
+
+	// double fork so the helper is reparented to init and never becomes
+	// a zombie of the launcher
+	setsid();
+	if (fork() != 0) _exit(0);
+
+	// an empty list, saved by an older build, is recorded again too
+	struct prefetch_header_t saved;
+	FILE *f = fopen(ROOT(PREFETCH_FILE), "r");
+	if (f != NULL && fread(&saved, sizeof(saved), 1, f) == 1 && saved.files > 0 &&
+		saved.magic == hdr.magic && saved.version == hdr.version && saved.page_size == hdr.page_size &&
+		saved.launcher_mtime == hdr.launcher_mtime && saved.launcher_size == hdr.launcher_size &&
+		!strncmp(saved.launcher, hdr.launcher, sizeof(hdr.launcher))) {
+		prefetch_replay(f, &saved);
+	} else {
+		prefetch_record(launcher_pid, &hdr);
+	}
+
+	if (f != NULL) fclose(f);
+	_exit(0);
+}
+
+void prefetch_report() {
+	FILE *f = fopen(ROOT(PREFETCH_FILE), "r");
+	struct prefetch_header_t hdr;
+
+	if (f == NULL || fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != PREFETCH_MAGIC) {
+		printf("No prefetch list in %s\n", ROOT(PREFETCH_FILE));
+		if (f != NULL) fclose(f);
+		return;
+	}
+
+	if (hdr.version != PREFETCH_VERSION) {
+		printf("Prefetch list version %d, expected %d\n", hdr.version, PREFETCH_VERSION);
+		fclose(f);
+		return;
+	}
+
+	printf("launcher: %s, %d files\n", hdr.launcher, hdr.files);
+
+	uint64_t total = 0;
+	char path[256];
+	for (int i = 0; i < hdr.files; i++) {
+		uint16_t len, ranges;
+		uint32_t mtime, size, range[2], pages = 0;
+
+		if (fread(&len, sizeof(len), 1, f) != 1 || len >= sizeof(path) ||
+			fread(path, len, 1, f) != 1 ||
+			fread(&mtime, sizeof(mtime), 1, f) != 1 ||
+			fread(&size, sizeof(size), 1, f) != 1 ||
+			fread(&ranges, sizeof(ranges), 1, f) != 1) {
+			printf("truncated list\n");
+			break;
+		}
+		path[len] = '\0';
+
+		for (int r = 0; r < ranges && fread(range, sizeof(range), 1, f) == 1; r++)
+			pages += range[1];
+
+		printf("%6u KiB %3u ranges  %s\n", pages * hdr.page_size / 1024, ranges, path);
+		total += (uint64_t)pages * hdr.page_size;
+	}
+
+	printf("total: %llu KiB\n", (unsigned long long)(total / 1024));
+	fclose(f);
+}
@@ -0,0 +1,38 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+
+// Record-and-replay page cache prefetcher for the launcher. When no valid
+// list exists, a detached helper samples the files the launcher (and its
+// children) map or open during its first seconds and saves the page ranges
+// mincore() reports as resident. On later boots the helper replays that
+// list with readahead() while the launcher starts.
+
+#define PREFETCH_FILE		"/boot/.prefetch"
+#define PREFETCH_MAGIC		0x46504652 // "RFPF"
+#define PREFETCH_VERSION	1
+#define PREFETCH_MAX_FILES	256
+#define PREFETCH_WINDOW_MS	6000	// how long the launcher is observed
+#define PREFETCH_SAMPLE_MS	200
+
+struct prefetch_header_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t files;
+	uint32_t page_size;
+	uint32_t launcher_mtime;	// list is stale once the launcher changes
+	uint32_t launcher_size;
+	char launcher[128];
+};
+
+// Each file entry follows the header:
+//   uint16_t path_len, char path[path_len], uint32_t mtime, uint32_t size,
+//   uint16_t ranges, then ranges * { uint32_t page, uint32_t pages }
+
+// Forks a detached helper which replays or records the list for launcher
+void prefetch_start(const char *launcher);
+
+void prefetch_report();
+
+#endif
@@ -0,0 +1,157 @@
+#include "progress.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+// Lines that start a phase, as printed by dosfstools 3 and 4 with -v
+static const struct {
+	int tool;
+	const char *prefix;
+	const char *phase;
+} markers[] = {
+	{ PROGRESS_FSCK, "Checking we can access", "Reading boot sector" },
+	{ PROGRESS_FSCK, "Starting check/repair", "Checking files" },
+	{ PROGRESS_FSCK, "Starting verification", "Verifying files" },
+	{ PROGRESS_FSCK, "Checking for unused clusters", "Checking unused clusters" },
+	{ PROGRESS_FSCK, "Reclaiming unconnected", "Reclaiming clusters" },
+	{ PROGRESS_FSCK, "Checking free cluster summary", "Updating free space" },
+	{ PROGRESS_MKFS, "Volume ID is", "Writing FATs" },
+};
+
+// sscanf() which also checks the text after the last conversion
+#define MATCH(line, fmt, ...)	(end = 0, sscanf(line, fmt "%n", __VA_ARGS__, &end) > 0 && end > 0)
+
+void progress_parse_init(struct progress_parse_t *p, int tool) {
+	memset(p, 0, sizeof(*p));
+	p->tool = tool;
+	p->phase = tool == PROGRESS_FSCK ? "Starting check" : "Reading geometry";
+}
+
+static void parse_fsck(struct progress_parse_t *p, const char *line) {
+	unsigned int a, b, c;
+	unsigned long long n;
+	int end;
+
+	if (MATCH(line, " %u bytes per logical sector", &a)) p->sector = a;
+	else if (MATCH(line, " %u FATs,", &a)) p->fats = a;
+	else if (MATCH(line, " %llu bytes per FAT", &n)) p->fat = n;
+
+	// "<device>: 12 files, 345/6789 clusters"
+	const char *s = strstr(line, ": ");
+	if (s != NULL && MATCH(s, ": %u files, %u/%u clusters", &a, &b, &c)) {
+		p->done = true;
+		p->phase = "Finishing";
+	}
+
+	// both FATs are read, directories come on top of that
+	if (p->fats && p->fat) p->total = p->fats * p->fat;
+}
+
+static void parse_mkfs(struct progress_parse_t *p, const char *line) {
+	unsigned int a;
+	unsigned long long n;
+	int end;
+
+	if (MATCH(line, "logical sector size is %u,", &a)) p->sector = a;
+	else if (MATCH(line, "FAT size is %llu sector", &n)) p->fat = n;
+	else if (MATCH(line, "There %*s %u reserved sector", &a)) p->reserved = a;
+	else if (MATCH(line, "filesystem has %u %*u-bit FAT", &a)) {
+		p->fats = a;
+		const char *s = strstr(line, " and ");
+		if (s != NULL && MATCH(s, " and %u sector", &a)) p->cluster = a;
+	}
+
+	// reserved sectors, the FATs and the root directory cluster are written
+	if (p->sector && p->fats && p->fat)
+		p->total = (uint64_t)(p->reserved + p->cluster + p->fats * p->fat) * p->sector;
+}
+
+bool progress_parse(struct progress_parse_t *p, const char *line) {
+	const char *phase = p->phase;
+	uint64_t total = p->total;
+
+	while (*line == ' ' || *line == '\t') line++;
+	for (unsigned int i = 0; i < sizeof(markers) / sizeof(markers[0]); i++) {
+		if (markers[i].tool == p->tool && !strncmp(line, markers[i].prefix, strlen(markers[i].prefix))) {
+			p->phase = markers[i].phase;
+			break;
+		}
+	}
+
+	if (p->tool == PROGRESS_FSCK) parse_fsck(p, line);
+	else parse_mkfs(p, line);
+
+	return p->phase != phase || p->total != total;
+}
+
+int progress_card(const char *dev) {
+	int card;
+	if (sscanf(dev, "/dev/mmcblk%d", &card) != 1) return -1;
+	return card;
+}
+
+// Sectors read plus sectors written, fields 3 and 7 of the block stat
+static int stat_sectors(const char *path, uint64_t *sectors) {
+	char s[256];
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	ssize_t len = read(fd, s, sizeof(s) - 1);
+	close(fd);
+	if (len <= 0) return -1;
+	s[len] = '\0';
+
+	unsigned long long r, w;
+	if (sscanf(s, "%*u %*u %llu %*u %*u %*u %llu", &r, &w) != 2) return -1;
+	*sectors = r + w;
+	return 0;
+}
+
+void progress_start(struct progress_t *p, int card, uint32_t now) {
+	memset(p, 0, sizeof(*p));
+	if (card >= 0) snprintf(p->stat, sizeof(p->stat), PROGRESS_STAT, card);
+	if (!p->stat[0] || stat_sectors(p->stat, &p->base) < 0) p->stat[0] = '\0';
+	p->start = p->window = now;
+}
+
+int progress_sample(struct progress_t *p, uint32_t now) {
+	uint64_t sectors;
+	if (!p->stat[0] || stat_sectors(p->stat, &sectors) < 0) return -1;
+
+	p->done = sectors > p->base ? (sectors - p->base) * PROGRESS_SECTOR : 0;
+	if (now - p->window >= PROGRESS_RATE_MS) {
+		uint32_t rate = (p->done - p->window_done) * 1000 / (now - p->window);
+		p->rate = p->rate ? (p->rate * 3 + rate) / 4 : rate;
+		p->window = now;
+		p->window_done = p->done;
+	}
+	return 0;
+}
+
+int progress_percent(const struct progress_t *p) {
+	if (!p->total) return -1;
+	if (p->done >= p->total) return 99; // until the tool exits
+	return p->done * 100 / p->total;
+}
+
+int progress_eta(const struct progress_t *p) {
+	if (!p->total || !p->rate) return -1;
+	if (p->done >= p->total) return 0;
+	return (p->total - p->done) / p->rate;
+}
+
+void progress_report(int tool, FILE *f) {
+	struct progress_parse_t p;
+	progress_parse_init(&p, tool);
+	printf("%-28s %14s\n", "phase", "total bytes");
+	printf("%-28s %14llu\n", p.phase, (unsigned long long)p.total);
+
+	char s[256], *save;
+	while (fgets(s, sizeof(s), f) != NULL) {
+		for (char *line = strtok_r(s, "\r\n", &save); line != NULL; line = strtok_r(NULL, "\r\n", &save)) {
+			if (progress_parse(&p, line)) printf("%-28s %14llu\n", p.phase, (unsigned long long)p.total);
+		}
+	}
+
+	printf("sector %u, %u FATs of %llu, %u reserved, cluster %u%s\n", p.sector, p.fats,
+		(unsigned long long)p.fat, p.reserved, p.cluster, p.done ? ", summary seen" : "");
+}
@@ -0,0 +1,71 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Progress of the fsck.vfat and mkfs.vfat runs. The tool's verbose output
+// is parsed line by line as it streams in, which gives the phase and the
+// number of bytes the tool has to read or write. The bytes it actually
+// moved come from the sectors read and written in /sys/block/<card>/stat,
+// sampled by the UI with one read per frame.
+
+#ifndef PROGRESS_STAT
+#define PROGRESS_STAT		"/sys/block/mmcblk%d/stat"
+#endif
+#define PROGRESS_SECTOR		512		// unit of the sysfs counters
+#define PROGRESS_RATE_MS	1000	// throughput window
+
+enum progress_tools {
+	PROGRESS_FSCK,
+	PROGRESS_MKFS,
+};
+
+// Output parser, fed one line at a time by the worker
+struct progress_parse_t {
+	int tool;
+	const char *phase;	// static label of the last phase marker seen
+	uint64_t total;		// bytes the tool reads or writes, 0 until known
+	bool done;			// fsck printed its summary
+
+	// geometry as printed by the tool
+	uint32_t sector;
+	uint32_t fats;
+	uint32_t reserved;
+	uint32_t cluster;	// sectors
+	uint64_t fat;		// bytes for fsck, sectors for mkfs
+};
+
+void progress_parse_init(struct progress_parse_t *p, int tool);
+
+// True when the phase or the total changed
+bool progress_parse(struct progress_parse_t *p, const char *line);
+
+// Sampler of the card the tool works on
+struct progress_t {
+	char stat[32];
+	uint64_t base;		// sectors moved before the tool started
+	uint64_t total;		// bytes, from the parser
+	uint64_t done;		// bytes moved since progress_start()
+	uint32_t start;		// ms
+	uint32_t window;	// ms, start of the throughput window
+	uint64_t window_done;
+	uint32_t rate;		// bytes/s, 0 until the first window is over
+};
+
+// Card number N of /dev/mmcblkN[pM], -1 for anything else
+int progress_card(const char *dev);
+
+void progress_start(struct progress_t *p, int card, uint32_t now);
+int progress_sample(struct progress_t *p, uint32_t now);
+
+// 0..99 while the tool runs, -1 while the total is unknown
+int progress_percent(const struct progress_t *p);
+
+// Seconds left at the current rate, -1 if unknown
+int progress_eta(const struct progress_t *p);
+
+// Replays a captured log of the tool from f, printing every change
+void progress_report(int tool, FILE *f);
+
+#endif
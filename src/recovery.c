@@ -1,8 +1,28 @@
-#include <SDL/SDL.h>
-#include <SDL/SDL_image.h>
-#include <SDL/SDL_ttf.h>
-#include "font.h"
-#include "background.h"
+#include "sdl_loader.h"
+#include "keymap.h"
+#include "gpio.h"
+#include "evdev.h"
+#include "replay.h"
+#include "swap.h"
+#include "exec.h"
+#include "mounts.h"
+#include "rtc.h"
+#include "boottrace.h"
+#include "intent.h"
+#include "prefetch.h"
+#include "bench.h"
+#include "atlas.h"
+#include "textcache.h"
+#include "background565.h"
+#include "rle565.h"
+#include "scale565.h"
+#include "fb.h"
+#include "render.h"
+#include "worker.h"
+#include "progress.h"
+#ifndef RETROFW_HEADLESS
+	#include "screens565.h" // rendered by the headless build
+#endif
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -13,11 +33,11 @@
 #include <linux/kd.h>
 #include <linux/fb.h>
 #include <linux/fs.h>
+#include <pthread.h>
 #include <ctime>
 #include <sys/time.h>   /* for settimeofday() */
 
 #ifndef TARGET_RETROFW
-	#define system(x) printf(x); printf("\n")
 	#define DBG(x) printf("%s:%d %s %s\n", __FILE__, __LINE__, __func__, x);
 #else
 	#define DBG(x)
@@ -25,45 +45,53 @@
 
 #define WIDTH  320
 #define HEIGHT 240
+#define FONT_SIZE 12 // of src/fontatlas.h, see the Makefile
+
+#define USB_LUN0 "/sys/devices/platform/musb_hdrc.0/gadget/gadget-lun0/file"
+#define USB_LUN1 "/sys/devices/platform/musb_hdrc.0/gadget/gadget-lun1/file"
+
+// GPIO key state read at boot; points to SDL's key state once SDL is up
+uint8_t boot_keys[SDLK_LAST];
+uint8_t *keys = boot_keys;
 
-#define GPIO_BASE		0x10010000
-#define PAPIN			((0x10010000 - GPIO_BASE) >> 2)
-#define PBPIN			((0x10010100 - GPIO_BASE) >> 2)
-#define PCPIN			((0x10010200 - GPIO_BASE) >> 2)
-#define PDPIN			((0x10010300 - GPIO_BASE) >> 2)
-#define PEPIN			((0x10010400 - GPIO_BASE) >> 2)
-#define PFPIN			((0x10010500 - GPIO_BASE) >> 2)
-
-#define BTN_X			SDLK_SPACE
-#define BTN_A			SDLK_LCTRL
-#define BTN_B			SDLK_LALT
-#define BTN_Y			SDLK_LSHIFT
-#define BTN_L			SDLK_TAB
-#define BTN_R			SDLK_BACKSPACE
-#define BTN_START		SDLK_RETURN
-#define BTN_SELECT		SDLK_ESCAPE
-#define BTN_BACKLIGHT	SDLK_3
-#define BTN_POWER		SDLK_END
-#define BTN_UP			SDLK_UP
-#define BTN_DOWN		SDLK_DOWN
-#define BTN_LEFT		SDLK_LEFT
-#define BTN_RIGHT		SDLK_RIGHT
-
-uint8_t *keys = SDL_GetKeyState(NULL);
-
-TTF_Font *font = NULL;
 SDL_Surface *screen = NULL;
 SDL_Surface *bg = NULL;
 SDL_Event event;
 
+// Set when the UI draws straight into the framebuffer (RETROFW_FB=<device>,
+// empty for /dev/fb0). SDL video is then never initialized and key events
+// come from the GPIO sampler.
+bool fb_ui = false;
+uint8_t fb_keys[SDLK_LAST]; // key state already reported as events
+
+// Set when keys come from /dev/input/event* instead of SDL or the GPIO
+// sampler, keys then points to boot_keys again. RETROFW_INPUT=sdl keeps
+// the old paths.
+bool evdev_ui = false;
+
+// The UI always draws a WIDTH x HEIGHT canvas. On larger panels it is
+// scaled by an integer factor and centered (letterboxed) on the display.
+struct ui_layout_t {
+	int scale, x, y;
+} layout = { 1, 0, 0 };
+SDL_Surface *display = NULL;	// SDL video surface, when it is not the canvas
+
+// RETROFW_OVERLAY shows the scaling time of the previous frame
+bool overlay = false;
+uint32_t scale_us = 0;
+
 SDL_Color txtColor = {200, 200, 220};
 SDL_Color titleColor = {200, 200, 0};
 SDL_Color subTitleColor = {0, 200, 0};
 SDL_Color powerColor = {200, 0, 0};
+SDL_Color dimColor = {90, 90, 100};
 
 static char buf[1024];
+bool build_stamp = true; // off for the screens baked into src/screens565.h
 uint8_t nextline = 24;
 
+struct intent_journal_t intents;
+
 enum modes {
 	MODE_UDC,
 	MODE_NETWORK,
@@ -75,14 +103,92 @@ enum modes {
 	MODE_MENU
 };
 
+// The UI thread runs one event loop, ui_loop(), in one of these states.
+// Long operations meanwhile run as jobs on the workers, see src/worker.h.
+enum ui_states {
+	STATE_MENU,
+	STATE_UDC,		// SELECT leaves for ui.back
+	STATE_NETWORK,
+	STATE_CONFIRM,	// SELECT + Y runs the operation of ui.confirm, B cancels
+	STATE_JOBS,		// a row per job, the spinner animates while any runs
+	STATE_DONE,		// all jobs done, reboots or powers off at ui.deadline
+	STATE_SWAP,		// refreshed at ui.deadline
+};
+
+#define UI_FRAME_MS		50		// event loop period
+#define SPINNER_MS		100
+#define DONE_MS			1000
+#define SWAP_REFRESH_MS	1000
+
+#define JOB_REBOOT		1		// job result: reboot when done
+#define JOBS_MAX		5		// rows of the jobs screen
+#define JOB_ROW_H		34
+
+enum job_kinds {
+	JOB_FSCK,
+	JOB_DEFL,
+	JOB_RESIZE,
+	JOB_FORMAT_EXT,
+};
+
+enum job_states {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_FINISHED,
+};
+
+// One operation on one card, queued on the worker lane of that card. The
+// lane only reads what job_add() set up and owns parse, the rest belongs to
+// the UI thread.
+struct job_t {
+	int kind;
+	int card;		// lane, 0 internal, 1 external
+	int intent;		// op of the journal it's part of, -1 if none
+	const char *name;
+	struct progress_parse_t parse;
+
+	int state;
+	uint32_t started;
+	uint32_t ms;
+	bool tool;		// a tool reports progress
+	bool tool_done;
+	const char *phase;
+	struct progress_t progress;
+};
+
+struct job_t jobs[JOBS_MAX];
+int job_count = 0;
+int jobs_left = 0;	// queued or running
+
+// The journal is shared by the lanes, intent_lock guards it and the number
+// of unfinished jobs of every op
+pthread_mutex_t intent_lock = PTHREAD_MUTEX_INITIALIZER;
+int intent_jobs[INTENT_MAX];
+
+struct ui_t {
+	int state;
+	int back;		// state SELECT returns to from USB/network mode, -1 quits
+	int confirm;	// screen of STATE_CONFIRM
+	int selected;
+	int drawn;		// menu selection on screen, -1 repaints everything
+	uint32_t started;	// of the first job
+	uint32_t ms;		// all jobs took
+	uint32_t spun;		// last spinner frame
+	uint32_t deadline;
+	bool reboot;	// a job asked for it
+	bool power;		// power button pressed while jobs run
+	const char *notice;	// replaces the menu footer until the next key
+} ui = { STATE_MENU, STATE_MENU, 0, 0, -1 };
+
 struct callback_map_t {
   const char *text;
   void (*callback)(void);
+  bool queue; // can be picked while jobs run
 };
 
 uint8_t file_exists(const char path[512]) {
 	struct stat s;
-	return !!(stat(path, &s) == 0 && (s.st_mode & S_IFREG || s.st_mode & S_IFBLK)); // exists and is file or block
+	return !!(stat(ROOT(path), &s) == 0 && (s.st_mode & S_IFREG || s.st_mode & S_IFBLK)); // exists and is file or block
 }
 
 // To return char for a value. For example '2'
@@ -124,39 +230,197 @@ char* deci2base(char res[], int base, int inputNum) {
 	return res;
 }
 
+void fb_ui_close() {
+	if (!fb_ui) return;
+	SDL_FreeSurface(screen);
+	screen = NULL;
+	fb_close();
+	gpio_close_keys();
+	fb_ui = false;
+}
+
 void quit(int err) {
 	DBG("");
-	system("sync");
-	font = NULL;
-	SDL_Quit();
-	TTF_Quit();
+	sync();
+#ifndef TARGET_RETROFW
+	struct text_cache_stats_t tc;
+	text_cache_stats(&tc);
+	printf("text cache: %u hits, %u misses, %u evictions, %u entries, %u bytes\n", tc.hits, tc.misses, tc.evictions, tc.entries, tc.bytes);
+#endif
+	text_cache_flush();
+	fb_ui_close();
+	if (sdl_loaded()) {
+		SDL_Quit();
+	}
 	exit(err);
 }
 
 void reboot() {
-	system("sync; reboot -f");
+	sync();
+	run("reboot", "-f", NULL);
 	quit(0);
 }
 
 void poweroff() {
-	system("sync; poweroff -f");
+	sync();
+	run("poweroff", "-f", NULL);
 	quit(0);
 }
 
 int draw_text(int x, int y, const char buf[64], SDL_Color txtColor) {
 	if (!strcmp(buf, "")) return y;
 	DBG("");
-	SDL_Surface *msg = TTF_RenderText_Blended(font, buf, txtColor);
-	SDL_Rect rect;
-	rect.x = x;
-	rect.y = y;
-	rect.w = msg->w;
-	rect.h = msg->h;
-	SDL_BlitSurface(msg, NULL, screen, &rect);
-	SDL_FreeSurface(msg);
-	return y + msg->h + 2;
+	int h = text_draw(screen, x, y, buf, txtColor, FONT_SIZE);
+	if (h < 0) return y;
+	return y + h + 2;
+}
+
+void ui_layout(int w, int h) {
+	layout.scale = (w >= 2 * WIDTH && h >= 2 * HEIGHT) ? 2 : 1;
+	layout.x = (w - WIDTH * layout.scale) / 2;
+	layout.y = (h - HEIGHT * layout.scale) / 2;
+}
+
+// Canvas position in a page of the framebuffer
+uint16_t *ui_fb_canvas(void *page) {
+	return (uint16_t *)((uint8_t *)page + layout.y * fb.pitch) + layout.x;
+}
+
+// Copies rects of the canvas into a display with the given pixels and
+// pitch, and turns them into display coordinates
+void ui_scale(uint16_t *pixels, int pitch, int n, SDL_Rect *rects) {
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (int i = 0; i < n; i++) {
+		SDL_Rect *r = &rects[i];
+		const uint16_t *src = (const uint16_t *)((const uint8_t *)screen->pixels + r->y * screen->pitch) + r->x;
+		r->x = layout.x + r->x * layout.scale;
+		r->y = layout.y + r->y * layout.scale;
+		uint16_t *dst = (uint16_t *)((uint8_t *)pixels + r->y * pitch) + r->x;
+		scale565(dst, pitch, src, screen->pitch, r->w, r->h, layout.scale);
+		r->w *= layout.scale;
+		r->h *= layout.scale;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	scale_us = (t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000;
+}
+
+// Repaints part of the screen with the background
+void draw_bg(const SDL_Rect *rect) {
+	SDL_Rect src = *rect, dst = *rect;
+	if (bg) SDL_BlitSurface(bg, &src, screen, &dst);
+	else SDL_FillRect(screen, &dst, 0);
+}
+
+// Replaces the build stamp corner with the last scaling time
+void draw_overlay(SDL_Rect *rect) {
+	rect->x = 250;
+	rect->y = 222;
+	rect->w = WIDTH - rect->x;
+	rect->h = HEIGHT - rect->y;
+	draw_bg(rect);
+
+	char s[16];
+	sprintf(s, "%uus", scale_us);
+	draw_text(255, 222, s, subTitleColor);
+}
+
+#ifdef RETROFW_HEADLESS
+// Nothing to show, the renderer reads the canvas
+void ui_update(int n, SDL_Rect *rects) {}
+void ui_flip() {}
+#else
+// Shows the given rectangles, nothing else may have changed since the
+// last flip. n == 0 shows the whole canvas.
+void ui_update(int n, SDL_Rect *rects) {
+	SDL_Rect r[n + 2];
+	if (n == 0) {
+		r[0].x = r[0].y = 0;
+		r[0].w = WIDTH;
+		r[0].h = HEIGHT;
+		n = 1;
+	} else {
+		memcpy(r, rects, n * sizeof(SDL_Rect));
+	}
+	if (overlay) draw_overlay(&r[n++]);
+
+	if (fb_ui) {
+		if (layout.scale != 1) ui_scale((uint16_t *)fb_back(), fb.pitch, n, r);
+
+		struct fb_rect_t fr[n];
+		for (int i = 0; i < n; i++) {
+			fr[i].x = r[i].x + (layout.scale == 1 ? layout.x : 0);
+			fr[i].y = r[i].y + (layout.scale == 1 ? layout.y : 0);
+			fr[i].w = r[i].w;
+			fr[i].h = r[i].h;
+		}
+		fb_present(fr, n);
+		if (layout.scale == 1) screen->pixels = ui_fb_canvas(fb_back());
+	} else if (display != NULL) {
+		if (SDL_MUSTLOCK(display)) SDL_LockSurface(display);
+		ui_scale((uint16_t *)display->pixels, display->pitch, n, r);
+		if (SDL_MUSTLOCK(display)) SDL_UnlockSurface(display);
+		SDL_UpdateRects(display, n, r);
+	} else {
+		SDL_UpdateRects(screen, n, r);
+	}
+}
+
+// Shows what was drawn since the last flip
+void ui_flip() {
+	if (!fb_ui && display == NULL && !overlay) {
+		SDL_Flip(screen);
+		return;
+	}
+	ui_update(0, NULL);
+}
+#endif
+
+// Fills e with a key change, keys[] follows the events
+int ui_key_event(SDL_Event *e, uint16_t key, uint8_t state) {
+	keys[key] = state;
+	e->type = state ? SDL_KEYDOWN : SDL_KEYUP;
+	e->key.state = state;
+	e->key.keysym.sym = (SDLKey)key;
+	return 1;
 }
 
+// Next key event, or 0 if there is none. A replayed script replaces the
+// keypad. Held UP and DOWN repeat on evdev only. On the framebuffer backend
+// one GPIO sample is taken when every earlier change has been reported.
+int ui_poll_event(SDL_Event *e) {
+	if (replay_mode() != REPLAY_OFF) {
+		struct replay_event_t r;
+		return replay_next(&r) ? ui_key_event(e, r.key, r.state) : 0;
+	}
+	if (evdev_ui) {
+		struct evdev_event_t ev;
+		return evdev_poll(&ev) ? ui_key_event(e, ev.key, ev.state) : 0;
+	}
+	if (!fb_ui) return SDL_PollEvent(e);
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 0; i < GPIO_KEYS; i++) {
+			uint16_t k = gpio_keys[i].key;
+			if (keys[k] == fb_keys[k]) continue;
+
+			fb_keys[k] = keys[k];
+			e->type = keys[k] ? SDL_KEYDOWN : SDL_KEYUP;
+			e->key.state = keys[k];
+			e->key.keysym.sym = (SDLKey)k;
+			return 1;
+		}
+		if (pass == 0 && gpio_poll_keys(keys) < 0) {
+			SDL_Delay(GPIO_WINDOW_MS); // no input source, do not spin
+			break;
+		}
+	}
+	return 0;
+}
+
+
 int draw_screen(const char title[64], const char footer[64]) {
 	DBG("");
 	SDL_Rect rect;
@@ -170,7 +434,7 @@ int draw_screen(const char title[64], const char footer[64]) {
 	// title
 	draw_text(247, 4, "RetroFW", titleColor);
 	draw_text(10, 4, title, titleColor);
-	draw_text(255, 222, deci2base(buf, 64, __BUILDTIME__), (SDL_Color){200, 200, 20});
+	if (build_stamp) draw_text(255, 222, deci2base(buf, 64, __BUILDTIME__), (SDL_Color){200, 200, 20});
 
 	rect.w = WIDTH - 20;
 	rect.h = 1;
@@ -186,39 +450,218 @@ int draw_screen(const char title[64], const char footer[64]) {
 	return 32;
 }
 
-int check_part() {
-	DBG("");
-	if (file_exists("/boot/.prsz")) return MODE_RESIZE;
-	if (file_exists("/boot/.defl")) return MODE_DEFL;
-	if (file_exists("/boot/.fsck")) return MODE_FSCK;
-	return MODE_START;
+enum screens {
+	SCREEN_FSCK,
+	SCREEN_DEFL,
+	SCREEN_RESIZE,
+	SCREEN_UDC,
+	SCREEN_NETWORK,
+	SCREEN_FORMAT_EXT,
+	SCREEN_FORMAT_EXT_RUN,
+	SCREEN_DATA_RESET,
+	SCREEN_COUNT
+};
+
+struct screen_line_t {
+	const char *text;
+	SDL_Color *color;
+};
+
+// Screens that never change, drawn by draw_static()
+struct screen_t {
+	const char *name;
+	const char *title;
+	const char *footer;
+	struct screen_line_t lines[6];
+};
+
+const struct screen_t screens[SCREEN_COUNT] = {
+	{ "fsck", "FILE SYSTEM CHECK", "", {
+		{ "Checking file system", &txtColor },
+		{ "This may take several minutes", &txtColor },
+		{ "Please wait...", &txtColor } } },
+	{ "defl", "DATA RESET", "", {
+		{ "Restoring default data", &txtColor },
+		{ "This may take several minutes", &txtColor },
+		{ "Please wait...", &txtColor } } },
+	{ "resize", "PARTITION MANAGER", "", {
+		{ "Updating partition table", &txtColor },
+		{ "This may take several minutes", &txtColor },
+		{ "Please wait...", &txtColor } } },
+	{ "udc", "USB MODE", "SELECT: EXIT", {
+		{ "- Mount the device to copy files", &txtColor },
+		{ "- Safely remove the USB drive", &txtColor },
+		{ "- Disconnect the USB cable", &txtColor } } },
+	{ "network", "NETWORK MODE", "SELECT: EXIT", {
+		{ "- Set up the network in your PC", &txtColor },
+		{ "- FTP or Telnet to 169.254.1.1", &txtColor },
+		{ "- Transfer files/run commands", &txtColor } } },
+	{ "format_ext", "FORMAT EXT SD", "SELECT + Y: CONFIRM     B: CANCEL", {
+		{ "WARNING", &powerColor },
+		{ "This will format the external", &txtColor },
+		{ "SD card and all files will", &txtColor },
+		{ "be deleted", &txtColor },
+		{ " ", &txtColor },
+		{ "THIS CAN'T BE UNDONE", &powerColor } } },
+	{ "format_ext_run", "FORMAT EXT SD", "", {
+		{ "Formatting external SD card", &txtColor },
+		{ "This may take several minutes", &txtColor },
+		{ "Please wait...", &txtColor } } },
+	{ "data_reset", "DATA RESET", "SELECT + Y: CONFIRM     B: CANCEL", {
+		{ "WARNING", &powerColor },
+		{ "This will format the data", &txtColor },
+		{ "partition and all files will", &txtColor },
+		{ "be deleted", &txtColor },
+		{ " ", &txtColor },
+		{ "THIS CAN'T BE UNDONE", &powerColor } } },
+};
+
+int draw_static(int id) {
+	const struct screen_t *sc = &screens[id];
+	int y = draw_screen(sc->title, sc->footer);
+	for (int i = 0; i < 6 && sc->lines[i].text; i++)
+		y = draw_text(10, y, sc->lines[i].text, *sc->lines[i].color);
+	return y;
 }
 
-void fsck() {
-	nextline = draw_screen("FILE SYSTEM CHECK", "");
-	nextline = draw_text(10, nextline, "Checking file system", txtColor);
-	nextline = draw_text(10, nextline, "This may take several minutes", txtColor);
-	nextline = draw_text(10, nextline, "Please wait...", txtColor);
-	SDL_Flip(screen);
+// Row of a job: name and phase, then the bar and numbers of its tool or
+// the time it took
+void draw_job(int i, bool update) {
+	struct job_t *job = &jobs[i];
+	// the longest phases run up to the right edge
+	SDL_Rect rect = { 10, (int16_t)(32 + i * JOB_ROW_H), WIDTH - 10, JOB_ROW_H };
+	draw_bg(&rect);
+
+	draw_text(10, rect.y, job->name, job->state == JOB_RUNNING ? subTitleColor : txtColor);
+	int y = draw_text(100, rect.y, job->phase, txtColor);
+	if (job->state == JOB_QUEUED) {
+		if (update) ui_update(1, &rect);
+		return;
+	}
 
-	DBG("");
+	int percent = job->state == JOB_FINISHED || job->tool_done ? 100 : job->tool ? progress_percent(&job->progress) : -1;
+	if (percent >= 0) {
+		SDL_Rect bar = { 10, (int16_t)(y + 3), 84, 8 };
+		SDL_FillRect(screen, &bar, SDL_MapRGB(screen->format, 200, 200, 200));
+		bar.x++, bar.y++, bar.w -= 2, bar.h -= 2;
+		SDL_FillRect(screen, &bar, 0);
+		bar.w = bar.w * percent / 100;
+		SDL_FillRect(screen, &bar, SDL_MapRGB(screen->format, 0, 200, 0));
+	}
 
-	if (file_exists("/boot/.fsck")) {
-		// first boot. remove fsck flag
-		system("rm /boot/.fsck");
+	uint32_t s = (job->state == JOB_FINISHED ? job->ms : now_ms() - job->started) / 1000;
+	if (job->state == JOB_RUNNING && job->tool && !job->tool_done) {
+		int n = 0, eta = progress_eta(&job->progress);
+		uint32_t rate = job->progress.rate;
+		if (percent >= 0) n += sprintf(buf + n, "%d%%  ", percent);
+		n += sprintf(buf + n, "%u.%u MB/s", rate / 1000000, rate / 100000 % 10);
+		if (eta >= 0) sprintf(buf + n, "  ETA %d:%02d", eta / 60, eta % 60);
 	} else {
-		// check external fs only after first boot (manual trigger)
-		system("fsck.vfat -va $(ls --color=never /dev/mmcblk1* | tail -n 1)");
+		sprintf(buf, "%u:%02u", s / 60, s % 60);
+	}
+	draw_text(100, y, buf, txtColor);
+
+	if (update) ui_update(1, &rect);
+}
+
+// Line below the rows: the total time once all jobs are done
+void draw_jobs_status(bool update) {
+	SDL_Rect rect = { 10, 32 + JOBS_MAX * JOB_ROW_H, WIDTH - 20, 16 };
+	draw_bg(&rect);
+
+	const char *then = ui.power ? "Powering off..." : ui.reboot ? "Rebooting..." : "";
+	if (jobs_left) sprintf(buf, "%s", ui.power ? "Powering off when done" : "");
+	else sprintf(buf, "Done in %u:%02u. %s", ui.ms / 60000, ui.ms / 1000 % 60, then);
+	draw_text(10, rect.y, buf, ui.power ? powerColor : txtColor);
+
+	if (update) ui_update(1, &rect);
+}
+
+// The jobs screen without the spinner
+int draw_jobs() {
+	int y = draw_screen("STORAGE JOBS", jobs_left ? "B: MENU" : ui.power || ui.reboot ? "" : "A: MENU");
+	for (int i = 0; i < job_count; i++)
+		draw_job(i, false);
+	draw_jobs_status(false);
+	return y;
+}
+
+// Switches the event loop to state, drawing what doesn't change in it
+void ui_enter(int state) {
+	ui.state = state;
+
+	switch (state) {
+		case STATE_MENU:
+			ui.drawn = -1;
+			break;
+		case STATE_UDC:
+			nextline = draw_static(SCREEN_UDC);
+			ui_flip();
+			break;
+		case STATE_NETWORK:
+			nextline = draw_static(SCREEN_NETWORK);
+			ui_flip();
+			break;
+		case STATE_CONFIRM:
+			nextline = draw_static(ui.confirm);
+			ui_flip();
+			break;
+		case STATE_JOBS:
+			draw_jobs();
+			ui_flip();
+			ui.spun = now_ms() - SPINNER_MS;
+			break;
+		case STATE_SWAP:
+			ui.deadline = now_ms();
+			break;
 	}
+}
 
-	system("sync; swapoff -a");
-	system("umount -fl /home/retrofw $(ls --color=never /dev/mmcblk0* | tail -n 1)");
-	system("fsck.vfat -va $(ls --color=never /dev/mmcblk0* | tail -n 1)");
+int check_part() {
+	DBG("");
+	if (intent_load(&intents) < 0) {
+		intent_import_legacy(&intents);
+	}
 
-	nextline = draw_text(10, nextline, "Done. Rebooting...", txtColor);
-	SDL_Flip(screen);
+	struct intent_op_t *op = intent_next(&intents);
+	if (op == NULL) return MODE_START;
+	if (op->op == OP_RESIZE) return MODE_RESIZE;
+	if (op->op == OP_DEFL) return MODE_DEFL;
+	return MODE_FSCK;
+}
 
-	reboot();
+// Output parser of a job's tool, on its lane
+void tool_line(const char *line, void *arg) {
+	struct progress_parse_t *p = (struct progress_parse_t *)arg;
+	if (!progress_parse(p, line)) return;
+	struct worker_msg_t msg = { WORKER_PROGRESS, 0, 0, p->total, p->phase };
+	worker_send(&msg);
+}
+
+// Runs a tool working on dev, its output drives the progress of job
+int tool_run(struct job_t *job, int tool, const char *dev, const char *const argv[]) {
+	progress_parse_init(&job->parse, tool);
+	struct worker_msg_t msg = { WORKER_TOOL, 0, progress_card(dev), 0, job->parse.phase };
+	worker_send(&msg);
+
+	int ret = run_argv_lines(argv, NULL, NULL, tool_line, &job->parse);
+
+	struct worker_msg_t end = { WORKER_PROGRESS, 0, 1, job->parse.total, "Done" };
+	worker_send(&end);
+	return ret;
+}
+
+void fsck_run(struct job_t *job) {
+	char dev[32];
+
+	DBG("");
+
+	if (!*glob_last(job->card ? "/dev/mmcblk1*" : "/dev/mmcblk0*", dev, sizeof(dev))) return;
+
+	sync();
+	mnt_release(dev, true);
+	const char *argv[] = { "fsck.vfat", "-va", dev, NULL };
+	tool_run(job, PROGRESS_FSCK, dev, argv);
 }
 
 void fatsize(char *size) {
@@ -244,174 +687,246 @@ void fatsize(char *size) {
 
 void udc() {
 	DBG("");
+	ui_enter(STATE_UDC);
 
-	nextline = draw_screen("USB MODE", "SELECT: EXIT");
-	nextline = draw_text(10, nextline, "- Mount the device to copy files", txtColor);
-	nextline = draw_text(10, nextline, "- Safely remove the USB drive", txtColor);
-	nextline = draw_text(10, nextline, "- Disconnect the USB cable", txtColor);
-
-	SDL_Flip(screen);
-
-	system("rmmod g_ether; rmmod g_file_storage; modprobe g_file_storage");
-	system("echo \"\" > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun1/file; echo \"$(ls --color=never /dev/mmcblk0* | tail -n 1)\" > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun1/file");
-	system("echo \"\" > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun0/file; echo \"$(ls --color=never /dev/mmcblk1* | tail -n 1)\" > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun0/file");
+	run("rmmod", "g_ether", NULL);
+	run("rmmod", "g_file_storage", NULL);
+	run("modprobe", "g_file_storage", NULL);
 
-	while (1) {
-		if (SDL_WaitEvent(&event) && event.type == SDL_KEYDOWN && event.key.keysym.sym == BTN_SELECT) { // SELECT
-			break;
-		}
-	}
+	char dev[32];
+	write_file(USB_LUN1, "\n");
+	write_file(USB_LUN1, glob_last("/dev/mmcblk0*", dev, sizeof(dev)));
+	write_file(USB_LUN0, "\n");
+	write_file(USB_LUN0, glob_last("/dev/mmcblk1*", dev, sizeof(dev)));
 }
 
 void network() {
 	DBG("");
-	nextline = draw_screen("NETWORK MODE", "SELECT: EXIT");
-	nextline = draw_text(10, nextline, "- Set up the network in your PC", txtColor);
-	nextline = draw_text(10, nextline, "- FTP or Telnet to 169.254.1.1", txtColor);
-	nextline = draw_text(10, nextline, "- Transfer files/run commands", txtColor);
-	SDL_Flip(screen);
-
-	system("rmmod g_file_storage; modprobe g_ether; ifdown usb0; ifup usb0");
+	ui_enter(STATE_NETWORK);
 
-	while (1) {
-		if (SDL_WaitEvent(&event) && event.type == SDL_KEYDOWN && event.key.keysym.sym == BTN_SELECT) { // SELECT
-			break;
-		}
-	}
+	run("rmmod", "g_file_storage", NULL);
+	run("modprobe", "g_ether", NULL);
+	run("ifdown", "usb0", NULL);
+	run("ifup", "usb0", NULL);
 }
 
 void network_ascii() {
-	system("rmmod g_file_storage; modprobe g_ether; ifdown usb0; ifup usb0");
-
-	system("modprobe fbcon");
-	system("echo -e \"\e[1;36m ____      _            \e[31m _____ _     _\" > /dev/tty0");
-	system("echo -e \"\e[36m|  _ \\ ___| |_ _ __ ___ \e[31m|  ___| | _ | |\" > /dev/tty0");
-	system("echo -e \"\e[36m| |_) / _ \\ __| '__/ _ \\\\\e[31m| |__ | |/ \\| |\" > /dev/tty0");
-	system("echo -e \"\e[36m|  _ <  __/ |_| | | '_' \e[31m|  __||  .-.  |\" > /dev/tty0");
-	system("echo -e \"\e[36m|_| \\_\\___|\\__|_|  \\___/\e[31m|_|   |_/   \\_|\" > /dev/tty0");
-	system("echo -e \"\e[0;37m\" > /dev/tty0");
-
-	system("echo '- Set up the USB network in your PC' > /dev/tty0");
-	system("echo '- FTP or Telnet to 169.254.1.1' > /dev/tty0");
-	system("echo '- Copy the files/run shell commands' > /dev/tty0");
-	system("echo '- Power off and reboot' > /dev/tty0");
+	fb_ui_close(); // the console draws on page 0
+
+	run("rmmod", "g_file_storage", NULL);
+	run("modprobe", "g_ether", NULL);
+	run("ifdown", "usb0", NULL);
+	run("ifup", "usb0", NULL);
+
+	run("modprobe", "fbcon", NULL);
+	write_file("/dev/tty0",
+		"\e[1;36m ____      _            \e[31m _____ _     _\n"
+		"\e[36m|  _ \\ ___| |_ _ __ ___ \e[31m|  ___| | _ | |\n"
+		"\e[36m| |_) / _ \\ __| '__/ _ \\\e[31m| |__ | |/ \\| |\n"
+		"\e[36m|  _ <  __/ |_| | | '_' \e[31m|  __||  .-.  |\n"
+		"\e[36m|_| \\_\\___|\\__|_|  \\___/\e[31m|_|   |_/   \\_|\n"
+		"\e[0;37m\n"
+		"\n"
+		"- Set up the USB network in your PC\n"
+		"- FTP or Telnet to 169.254.1.1\n"
+		"- Copy the files/run shell commands\n"
+		"- Power off and reboot\n");
 
 	while (1) sleep(1000000);
 }
 
-void format_ext() {
-	nextline = draw_screen("FORMAT EXT SD", "SELECT + Y: CONFIRM     B: CANCEL");
-	nextline = draw_text(10, nextline, "WARNING", powerColor);
-	nextline = draw_text(10, nextline, "This will format the external", txtColor);
-	nextline = draw_text(10, nextline, "SD card and all files will", txtColor);
-	nextline = draw_text(10, nextline, "be deleted", txtColor);
-	nextline = draw_text(10, nextline, " ", txtColor);
-	nextline = draw_text(10, nextline, "THIS CAN'T BE UNDONE", powerColor);
-	SDL_Flip(screen);
+void format_ext_run(struct job_t *job) {
+	sync();
+	mnt_release("/dev/mmcblk1*", true);
+	run_input("o\nn\np\n1\n\n\nw\n", "fdisk", "/dev/mmcblk1", NULL);
+	// run_input("start=2048, type=83\n", "sfdisk", "/dev/mmcblk1", NULL);
+
+	sync();
+	run("partprobe", "/dev/mmcblk1", NULL); // not the card the other lane works on
+	const char *argv[] = { "mkfs.vfat", "-F32", "-va", "-n", "RETROFW_SD", "/dev/mmcblk1p1", NULL };
+	tool_run(job, PROGRESS_MKFS, "/dev/mmcblk1p1", argv);
+	mnt_mount("/dev/mmcblk1*");
+}
 
-	while (SDL_WaitEvent(&event)) {
-		if (event.type != SDL_KEYDOWN) continue;
+void format_ext() {
+	ui.confirm = SCREEN_FORMAT_EXT;
+	ui_enter(STATE_CONFIRM);
+}
 
-		if (keys[BTN_SELECT] && keys[BTN_Y]) {
-			nextline = draw_screen("FORMAT EXT SD", "");
-			nextline = draw_text(10, nextline, "Formatting external SD card", txtColor);
-			nextline = draw_text(10, nextline, "This may take several minutes", txtColor);
-			nextline = draw_text(10, nextline, "Please wait...", txtColor);
-			SDL_Flip(screen);
+void format_int_run(struct job_t *job) {
+	sync();
+	mnt_release("/dev/mmcblk0p[23]", true);
+	run("fatlabel", "/dev/mmcblk0p1", "rootfs", NULL);
+	const char *argv[] = { "mkfs.vfat", "-F32", "-va", "-n", "RETROFW", "/dev/mmcblk0p3", NULL };
+	tool_run(job, PROGRESS_MKFS, "/dev/mmcblk0p3", argv);
+	run("mkswap", "/dev/mmcblk0p2", NULL);
+}
 
-			system("sync; swapoff -a");
-			system("umount -fl /dev/mmcblk1* &> /dev/null");
-			system("(echo o; echo n; echo p; echo 1; echo  ; echo  ; echo w; ) | fdisk /dev/mmcblk1");
-			// system("echo 'start=2048, type=83' | sfdisk /dev/mmcblk1");
+void fatresize_run() {
+	DBG("");
 
-			system("sync; partprobe");
-			system("mkfs.vfat -F32 -va -n 'RETROFW_SD' /dev/mmcblk1p1");
-			system("mount -a");
+#ifdef TARGET_RETROFW
+	sync();
+	mnt_release("/dev/mmcblk0p[23]", true);
+	run_input("start=278528, size=128M, type=82\n", "sfdisk", "--append", "--no-reread", "/dev/mmcblk0", NULL);
+	run_input("start=540672, type=c\n", "sfdisk", "--append", "--no-reread", "/dev/mmcblk0", NULL);
+	run("partprobe", "/dev/mmcblk0", NULL);
+#endif
+}
 
-			nextline = draw_text(10, nextline, "Done.", txtColor);
-			SDL_Flip(screen);
+// Worker side of a job, on the lane of its card
+int job_run(int id) {
+	struct job_t *job = &jobs[id];
+
+	if (job->intent >= 0) {
+		pthread_mutex_lock(&intent_lock);
+		struct intent_op_t *op = &intents.ops[job->intent];
+		if (op->op == OP_RESIZE) {
+			// appending partitions twice would break the table, so a resize
+			// interrupted by a power loss is not retried
+			op->state = INTENT_DONE;
+			intent_jobs[job->intent] = 0;
+		} else {
+			op->state = INTENT_RUNNING;
+		}
+		intent_save(&intents);
+		pthread_mutex_unlock(&intent_lock);
+	}
 
+	switch (job->kind) {
+		case JOB_FSCK:
+			fsck_run(job);
+			break;
+		case JOB_DEFL:
+			format_int_run(job);
+			break;
+		case JOB_RESIZE:
+			fatresize_run();
 			break;
-		} else if (keys[BTN_B]) {
+		case JOB_FORMAT_EXT:
+			format_ext_run(job);
 			break;
+	}
+
+	if (job->intent >= 0 && job->kind != JOB_RESIZE) {
+		pthread_mutex_lock(&intent_lock);
+		if (--intent_jobs[job->intent] == 0) {
+			intents.ops[job->intent].state = INTENT_DONE;
+			intent_save(&intents);
 		}
+		pthread_mutex_unlock(&intent_lock);
 	}
+	return job->kind == JOB_FORMAT_EXT ? 0 : JOB_REBOOT;
 }
 
-void format_int() {
-	nextline = draw_screen("DATA RESET", "");
-	nextline = draw_text(10, nextline, "Restoring default data", txtColor);
-	nextline = draw_text(10, nextline, "This may take several minutes", txtColor);
-	nextline = draw_text(10, nextline, "Please wait...", txtColor);
-	SDL_Flip(screen);
+// Queues a job, intent_lock is held when it's part of an op of the journal
+int job_add(int kind, int card, int intent, const char *name) {
+	if (!jobs_left) job_count = 0; // the previous batch is over
+	if (job_count == JOBS_MAX) return -1;
+
+	struct job_t *job = &jobs[job_count];
+	memset(job, 0, sizeof(*job));
+	job->kind = kind;
+	job->card = card;
+	job->intent = intent;
+	job->name = name;
+	job->phase = "Queued";
+
+	if (intent >= 0) intent_jobs[intent]++;
+	if (worker_start(card, job_run, job_count) < 0) {
+		if (intent >= 0) intent_jobs[intent]--;
+		return -1;
+	}
 
-	system("sync; swapoff -a");
-	system("umount -fl /home/retrofw /dev/mmcblk*");
-	system("fatlabel /dev/mmcblk0p1 rootfs");
-	system("mkfs.vfat -F32 -va -n 'RETROFW' /dev/mmcblk0p3");
-	system("mkswap /dev/mmcblk0p2");
-	system("rm /boot/.defl");
-	fsck();
+	if (!jobs_left) ui.started = now_ms();
+	job_count++;
+	jobs_left++;
+	return 0;
 }
 
-void fatresize() {
-	DBG("");
-	nextline = draw_screen("PARTITION MANAGER", "");
-	nextline = draw_text(10, nextline, "Updating partition table", txtColor);
-	nextline = draw_text(10, nextline, "This may take several minutes", txtColor);
-	nextline = draw_text(10, nextline, "Please wait...", txtColor);
-	SDL_Flip(screen);
-
-#ifdef TARGET_RETROFW
-	system("rm /boot/.prsz");
-	system("sync; swapoff -a");
-	system("umount -fl /home/retrofw /dev/mmcblk*");
-	system("echo \"start=278528, size=128M, type=82\" | sfdisk --append --no-reread /dev/mmcblk0");
-	system("echo \"start=540672, type=c\" | sfdisk --append --no-reread /dev/mmcblk0");
-	system("partprobe");
-#endif
+// Queues the jobs of every pending op of the journal which has none yet.
+// Ops on the internal card keep their order on its lane, the external card
+// is checked at the same time. Returns how many jobs were queued.
+int jobs_from_intents() {
+	int queued = 0;
+	pthread_mutex_lock(&intent_lock);
+	for (int i = 0; i < intents.count; i++) {
+		struct intent_op_t *op = &intents.ops[i];
+		if (op->state == INTENT_DONE || intent_jobs[i]) continue;
+
+		switch (op->op) {
+			case OP_RESIZE:
+				queued += job_add(JOB_RESIZE, 0, i, "Resize") == 0;
+				break;
+			case OP_DEFL:
+				queued += job_add(JOB_DEFL, 0, i, "Reset") == 0;
+				break;
+			case OP_FSCK:
+				// check external fs only after first boot (manual trigger)
+				if ((op->param & FSCK_EXTERNAL) && file_exists("/dev/mmcblk1")) queued += job_add(JOB_FSCK, 1, i, "Check ext") == 0;
+				queued += job_add(JOB_FSCK, 0, i, "Check int") == 0;
+				break;
+		}
+	}
+	pthread_mutex_unlock(&intent_lock);
+	return queued;
+}
 
-	nextline = draw_text(10, nextline, "Done. Rebooting...", txtColor);
-	SDL_Flip(screen);
-	SDL_Delay(1e3);
-	reboot();
+int intent_queue(int op, uint32_t param) {
+	pthread_mutex_lock(&intent_lock);
+	int ret = intent_add(&intents, op, param);
+	pthread_mutex_unlock(&intent_lock);
+	return ret;
 }
 
-void data_reset() {
-	DBG("");
-	nextline = draw_screen("DATA RESET", "SELECT + Y: CONFIRM     B: CANCEL");
-	nextline = draw_text(10, nextline, "WARNING", powerColor);
-	nextline = draw_text(10, nextline, "This will format the data", txtColor);
-	nextline = draw_text(10, nextline, "partition and all files will", txtColor);
-	nextline = draw_text(10, nextline, "be deleted", txtColor);
-	nextline = draw_text(10, nextline, " ", txtColor);
-	nextline = draw_text(10, nextline, "THIS CAN'T BE UNDONE", powerColor);
-	SDL_Flip(screen);
+// The jobs screen, or the menu saying so when nothing could be queued
+void jobs_show(int queued) {
+	if (queued > 0) {
+		ui_enter(STATE_JOBS);
+		return;
+	}
+	ui.notice = "Queue full";
+	ui_enter(STATE_MENU);
+}
 
-	while (SDL_WaitEvent(&event)) {
-		if (event.type != SDL_KEYDOWN) continue;
+void fsck() {
+	jobs_show(intent_queue(OP_FSCK, FSCK_EXTERNAL) == 0 ? jobs_from_intents() : 0);
+}
 
-		if (keys[BTN_SELECT] && keys[BTN_Y]) {
-			format_int();
-			break;
-		} else if (keys[BTN_B]) {
-			break;
-		}
+void format_int() {
+	// the check is skipped rather than the reset when only one op fits
+	if (intent_queue(OP_DEFL, 0) < 0) {
+		jobs_show(0);
+		return;
 	}
+	intent_queue(OP_FSCK, FSCK_EXTERNAL);
+	jobs_show(jobs_from_intents());
+}
+
+void fatresize() {
+	jobs_show(intent_queue(OP_RESIZE, 0) == 0 ? jobs_from_intents() : 0);
+}
+
+void data_reset() {
+	DBG("");
+	ui.confirm = SCREEN_DATA_RESET;
+	ui_enter(STATE_CONFIRM);
 }
 
 void stop() {
 	DBG("");
-	system("echo '' > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun0/file");
-	system("echo '' > /sys/devices/platform/musb_hdrc.0/gadget/gadget-lun1/file");
-	system("sync");
-	system("killall dnsmasq; rmmod g_ether; rmmod g_file_storage");
-	system("mount -a");
+	write_file(USB_LUN0, "\n");
+	write_file(USB_LUN1, "\n");
+	sync();
+	run("killall", "dnsmasq", NULL);
+	run("rmmod", "g_ether", NULL);
+	run("rmmod", "g_file_storage", NULL);
+	mnt_mount_all();
 }
 
 void opkrun(int argc, char* argv[]) {
-	snprintf(buf, sizeof(buf), "umount -fl /mnt &> /dev/null; mount -o loop \"%s\" /mnt", argv[3]);
-	system(buf);
+	run("umount", "-fl", "/mnt", NULL);
+	run("mount", "-o", "loop", argv[3], "/mnt", NULL);
 
 	snprintf(buf, sizeof(buf), "HOME='%s' exec /mnt/", getenv("HOME"));
 
@@ -426,7 +941,7 @@ void opkrun(int argc, char* argv[]) {
 }
 
 void cls() {
-	int fd = open("/dev/tty0", O_RDONLY);
+	int fd = open(ROOT("/dev/tty0"), O_RDONLY);
 	if (fd > 0) {
 		ioctl(fd, VT_UNLOCKSWITCH, 1);
 		ioctl(fd, KDSETMODE, KD_TEXT);
@@ -435,30 +950,292 @@ void cls() {
 	}
 }
 
+void draw_swap() {
+	struct zram_stat_t zs;
+	struct swap_entry_t swaps[SWAP_MAX];
+
+	nextline = draw_screen("SWAP STATUS", "SELECT: EXIT");
+
+	if (zram_stat(&zs) == 0) {
+		uint32_t orig = zs.orig / 1024, compr = zs.compr / 1024, ratio = compr ? orig * 100 / compr : 0;
+		sprintf(buf, "zram: %d KiB -> %d KiB (%d.%02dx)", orig, compr, ratio / 100, ratio % 100);
+		nextline = draw_text(10, nextline, buf, subTitleColor);
+		sprintf(buf, "RAM used %d KiB of %d KiB disk", (uint32_t)(zs.used / 1024), (uint32_t)(zs.disksize / 1024));
+		nextline = draw_text(10, nextline, buf, txtColor);
+	} else {
+		nextline = draw_text(10, nextline, "zram not active", txtColor);
+	}
+	nextline = draw_text(10, nextline, " ", txtColor);
+
+	int n = swap_list(swaps, SWAP_MAX);
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "%s: %ld/%ld MiB, prio %d", swaps[i].name, swaps[i].used / 1024, swaps[i].size / 1024, swaps[i].prio);
+		nextline = draw_text(10, nextline, buf, txtColor);
+	}
+
+	ui_flip();
+}
+
+void swap_status() {
+	DBG("");
+	ui_enter(STATE_SWAP);
+}
+
 struct callback_map_t cb_map[] = {
-  { "Network Mode", network_ascii },
-  { "USB Mode", udc },
-  { "Check File System", fsck },
-  // { "Resize File System", fatresize },
-  { "Data Reset", data_reset },
-  { "Format Ext SD Card", format_ext },
-  { "Reboot", reboot },
-  { "Power Off", poweroff },
+  { "Network Mode", network_ascii, false },
+  { "USB Mode", udc, false },
+  { "Check File System", fsck, true },
+  // { "Resize File System", fatresize, true },
+  { "Data Reset", data_reset, true },
+  { "Format Ext SD Card", format_ext, true },
+  { "Swap Status", swap_status, true },
+  { "Reboot", reboot, false },
+  { "Power Off", poweroff, false },
 };
 unsigned int cb_size = (sizeof(cb_map) / sizeof(cb_map[0]));
 
+// What can't be picked while jobs run is dimmed
+SDL_Color menu_color(int i, int selected) {
+	if (selected == i) return subTitleColor;
+	return jobs_left && !cb_map[i].queue ? dimColor : txtColor;
+}
+
+// Main menu with row tops in row_y, row_y[cb_size] is the bottom of the last
+int draw_menu(int selected, int *row_y) {
+	int y = draw_screen("RECOVERY MODE", ui.notice ? ui.notice : jobs_left ? "A: SELECT     B: JOBS" : "A: SELECT");
+
+	for (int i = 0; i < cb_size; i++) {
+		row_y[i] = y;
+		y = draw_text(10, y, cb_map[i].text, menu_color(i, selected));
+	}
+	row_y[cb_size] = y;
+	return y;
+}
+
+int menu_row_y[sizeof(cb_map) / sizeof(cb_map[0]) + 1];
+
+void ui_menu() {
+	if (ui.drawn < 0) {
+		nextline = draw_menu(ui.selected, menu_row_y);
+		ui_flip();
+	} else if (ui.drawn != ui.selected) {
+		// only the rows of the old and the new selection change
+		SDL_Rect rects[2];
+		int rows[2] = { ui.drawn, ui.selected };
+		for (int r = 0; r < 2; r++) {
+			int i = rows[r];
+			rects[r].x = 10;
+			rects[r].y = menu_row_y[i];
+			rects[r].w = WIDTH - 20;
+			rects[r].h = menu_row_y[i + 1] - menu_row_y[i];
+			draw_bg(&rects[r]);
+			draw_text(10, menu_row_y[i], cb_map[i].text, menu_color(i, ui.selected));
+		}
+		ui_update(2, rects);
+	}
+	ui.drawn = ui.selected;
+}
+
+// Spinner and total time of the jobs in the footer
+void ui_spinner(int frame) {
+	SDL_Rect rect = { 170, 222, 100, HEIGHT - 222 };
+	draw_bg(&rect);
+
+	uint32_t s = (now_ms() - ui.started) / 1000;
+	sprintf(buf, "%c  %u:%02u", "|/-\\"[frame % 4], s / 60, s % 60);
+	draw_text(170, 222, buf, subTitleColor);
+	ui_update(1, &rect);
+}
+
+void ui_key(int key) {
+	switch (ui.state) {
+		case STATE_MENU:
+			if (ui.notice) {
+				ui.notice = NULL;
+				ui.drawn = -1;
+			}
+			if (key == BTN_UP) {
+				ui.selected--;
+				if (ui.selected < 0) ui.selected = cb_size - 1;
+			} else if (key == BTN_DOWN) {
+				ui.selected++;
+				if (ui.selected >= cb_size) ui.selected = 0;
+			} else if (key == BTN_LEFT) {
+				ui.selected = 0;
+			} else if (key == BTN_RIGHT) {
+				ui.selected = cb_size - 1;
+			} else if (key == BTN_A && (!jobs_left || cb_map[ui.selected].queue)) {
+				ui.drawn = -1;
+				cb_map[ui.selected].callback();
+			} else if (key == BTN_B && jobs_left) {
+				ui_enter(STATE_JOBS);
+			}
+			break;
+		case STATE_UDC:
+		case STATE_NETWORK:
+			if (key != BTN_SELECT) break;
+			if (ui.back < 0) {
+				stop();
+				quit(0);
+			}
+			ui_enter(ui.back);
+			break;
+		case STATE_CONFIRM:
+			if (keys[BTN_SELECT] && keys[BTN_Y]) {
+				if (ui.confirm == SCREEN_DATA_RESET) {
+					format_int();
+				} else {
+					jobs_show(job_add(JOB_FORMAT_EXT, 1, -1, "Format ext") == 0);
+				}
+			} else if (key == BTN_B) {
+				ui_enter(STATE_MENU);
+			}
+			break;
+		case STATE_JOBS:
+			if (key == BTN_B || (key == BTN_A && !jobs_left)) {
+				ui_enter(STATE_MENU);
+			} else if (key == BTN_POWER && jobs_left && !ui.power) {
+				// a half formatted card is worse than waiting, power off afterwards
+				ui.power = true;
+				draw_jobs_status(true);
+			}
+			break;
+		case STATE_SWAP:
+			if (key == BTN_SELECT) ui_enter(STATE_MENU);
+			break;
+	}
+}
+
+// All jobs are done, the device reboots or powers off if one asked for it
+void jobs_done() {
+	ui.ms = now_ms() - ui.started;
+	if (ui.power || ui.reboot) {
+		ui_enter(STATE_JOBS);
+		ui.state = STATE_DONE;
+		ui.deadline = now_ms() + DONE_MS;
+	} else if (ui.state == STATE_JOBS) {
+		ui_enter(STATE_JOBS);
+	} else if (ui.state == STATE_MENU) {
+		ui.drawn = -1;
+	}
+}
+
+void ui_message(const struct worker_msg_t *msg) {
+	// until a tool reports its own phase
+	static const char *phases[] = { "Starting check", "Formatting", "Partitioning", "Partitioning" };
+	struct job_t *job = &jobs[msg->job];
+
+	switch (msg->type) {
+		case WORKER_START:
+			job->state = JOB_RUNNING;
+			job->started = now_ms();
+			job->phase = phases[job->kind];
+			break;
+		case WORKER_TOOL:
+			job->tool = true;
+			job->tool_done = false;
+			job->phase = msg->text;
+			progress_start(&job->progress, msg->value, now_ms());
+			break;
+		case WORKER_PROGRESS:
+			job->phase = msg->text;
+			job->progress.total = msg->size;
+			job->tool_done = msg->value;
+			break;
+		case WORKER_DONE:
+			job->state = JOB_FINISHED;
+			job->ms = now_ms() - job->started;
+			job->phase = "Done";
+			if (msg->value & JOB_REBOOT) ui.reboot = true;
+			if (--jobs_left == 0) {
+				jobs_done();
+				return;
+			}
+			break;
+	}
+	if (ui.state == STATE_JOBS) draw_job(msg->job, true);
+}
+
+void ui_tick(uint32_t now) {
+	switch (ui.state) {
+		case STATE_MENU:
+			ui_menu();
+			break;
+		case STATE_JOBS:
+			if (!jobs_left || now - ui.spun < SPINNER_MS) break;
+			ui.spun = now;
+			ui_spinner((now - ui.started) / SPINNER_MS);
+			for (int i = 0; i < job_count; i++) {
+				if (jobs[i].state != JOB_RUNNING) continue;
+				if (jobs[i].tool && !jobs[i].tool_done) progress_sample(&jobs[i].progress, now);
+				draw_job(i, true);
+			}
+			break;
+		case STATE_DONE:
+			if ((int32_t)(now - ui.deadline) < 0) break;
+			if (ui.power) poweroff();
+			reboot();
+			break;
+		case STATE_SWAP:
+			if ((int32_t)(now - ui.deadline) < 0) break;
+			draw_swap();
+			ui.deadline = now + SWAP_REFRESH_MS;
+			break;
+	}
+}
+
+// The only loop of the UI: keys, worker messages and animations are handled
+// every UI_FRAME_MS, nothing in it waits for an operation to finish
+void ui_loop() {
+	struct worker_msg_t msg;
+
+	while (1) {
+		uint32_t frame = now_ms();
+		int handled = 0;
+		replay_frame_begin();
+
+		while (ui_poll_event(&event)) {
+			if (event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) continue;
+			replay_write(event.key.keysym.sym, event.key.state);
+			if (event.type == SDL_KEYDOWN) ui_key(event.key.keysym.sym);
+			handled++;
+		}
+		while (worker_poll(&msg)) ui_message(&msg);
+		ui_tick(now_ms());
+
+		if (replay_frame_end(handled)) {
+			replay_report();
+			quit(0);
+		}
+		if (replay_mode() == REPLAY_FAST) continue;
+
+		// evdev wakes the loop as soon as a key changes
+		uint32_t spent = now_ms() - frame;
+		if (spent >= UI_FRAME_MS) continue;
+		if (evdev_ui) evdev_wait(UI_FRAME_MS - spent);
+		else SDL_Delay(UI_FRAME_MS - spent);
+	}
+}
+
 void sync_date_time(time_t t) {
 #if defined(TARGET_RETROFW)
 	struct timeval tv = { t, 0 };
 	settimeofday(&tv, NULL);
-	system("hwclock --systohc &");
+	rtc_write(t);
 #endif
 }
 
 void init_date_time() {
-	system("hwclock --hctosys");
+	time_t now;
 
-	time_t now = time(0);
+#if defined(TARGET_RETROFW)
+	if (rtc_read(&now) == 0) {
+		struct timeval tv = { now, 0 };
+		settimeofday(&tv, NULL);
+	}
+#endif
+
+	now = time(0);
 	const uint32_t t = __BUILDTIME__;
 
 	if (now < t) {
@@ -466,28 +1243,372 @@ void init_date_time() {
 	}
 }
 
+// Wraps the back page of the framebuffer in the screen surface
+int fb_ui_open(const char *dev) {
+	if (fb_open(dev) < 0) return -1;
+
+	if (!fb.rgb565 || fb.w < WIDTH || fb.h < HEIGHT) {
+		printf("%s: %dx%d %d bpp, not usable\n", dev, fb.w, fb.h, fb.bpp);
+		fb_close();
+		return -1;
+	}
+
+	// 1:1 draws straight into the page, 2x scales a canvas on every flip
+	ui_layout(fb.w, fb.h);
+	if (layout.x || layout.y) memset(fb.mem, 0, fb.size);
+	if (layout.scale == 1) screen = SDL_CreateRGBSurfaceFrom(ui_fb_canvas(fb_back()), WIDTH, HEIGHT, 16, fb.pitch, 0xf800, 0x07e0, 0x001f, 0);
+	else screen = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, 16, 0xf800, 0x07e0, 0x001f, 0);
+	if (screen == NULL) {
+		fb_close();
+		return -1;
+	}
+
+	memcpy(fb_keys, keys, sizeof(fb_keys)); // keys held at boot are not events
+	gpio_open_keys();
+	overlay = getenv("RETROFW_OVERLAY") != NULL;
+	fb_ui = true;
+	return 0;
+}
+
+#ifdef RETROFW_HEADLESS
+// The renderer runs on the build host, the network console is no fallback there
 void sdl_init() {
+	if (!sdl_load()) {
+		fprintf(stderr, "Could not load SDL libraries\n");
+		exit(1);
+	}
+	screen = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, 16, 0xf800, 0x07e0, 0x001f, 0);
+}
+#else
+void sdl_init() {
+	if (!sdl_load()) {
+		printf("Could not load SDL libraries\n");
+		network_ascii();
+	}
+
+	// SDL only draws into surfaces then, and SDL_Delay() needs no SDL_Init()
+	const char *dev = getenv("RETROFW_FB");
+	if (dev != NULL && (fb_ui || fb_ui_open(*dev ? dev : ROOT(FB_DEV)) == 0)) return;
+
 	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
 		printf("Could not initialize SDL: %s\n", SDL_GetError());
 		network_ascii();
 	}
 
 	SDL_ShowCursor(SDL_DISABLE);
-	screen = SDL_SetVideoMode(WIDTH, HEIGHT, 16, SDL_SWSURFACE);
+
+	int w = WIDTH, h = HEIGHT;
+#ifdef TARGET_RETROFW
+	fb_mode(ROOT(FB_DEV), &w, &h);
+#endif
+	if (w != WIDTH || h != HEIGHT) {
+		// native mode, the canvas is scaled into it on every flip
+		ui_layout(w, h);
+		display = SDL_SetVideoMode(w, h, 16, SDL_SWSURFACE);
+		if (display && atlas_supports(display->format) && w >= WIDTH && h >= HEIGHT) {
+			screen = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, 16, 0xf800, 0x07e0, 0x001f, 0);
+		}
+		if (screen == NULL) {
+			display = NULL;
+			ui_layout(WIDTH, HEIGHT);
+		}
+	}
+	if (screen == NULL) screen = SDL_SetVideoMode(WIDTH, HEIGHT, 16, SDL_SWSURFACE);
+	overlay = getenv("RETROFW_OVERLAY") != NULL;
 	SDL_EnableKeyRepeat(0, 0);
 	SDL_PumpEvents();
+	keys = SDL_GetKeyState(NULL);
 }
+#endif
+
+// Writes the pre-rendered screen of a mode straight to the framebuffer,
+// long before SDL and the UI are up
+void splash(int id) {
+#ifndef RETROFW_HEADLESS
+	if (screens565[id].rle == NULL || fb_ui || fb_open(ROOT(FB_DEV)) < 0) return;
+
+	if (fb.rgb565 && fb.w >= SCREENS565_W && fb.h >= SCREENS565_H) {
+		ui_layout(fb.w, fb.h);
+		memset(fb_back(), 0, fb.pitch * fb.h);
+
+		uint16_t *px = ui_fb_canvas(fb_back());
+		int pitch = fb.pitch;
+		if (layout.scale != 1) {
+			px = (uint16_t *)malloc(SCREENS565_W * SCREENS565_H * 2);
+			pitch = SCREENS565_W * 2;
+		}
+
+		if (px != NULL && rle565_decode(screens565[id].rle, screens565[id].words, px, SCREENS565_W, SCREENS565_H, pitch) == 0) {
+			if (layout.scale != 1) scale565(ui_fb_canvas(fb_back()), fb.pitch, px, pitch, SCREENS565_W, SCREENS565_H, layout.scale);
+			fb_present(NULL, 0);
+		}
+		if (layout.scale != 1) free(px);
+	}
+	fb_close();
+#endif
+}
+
+void ui_init() {
+	sdl_init();
+
+	bg = SDL_CreateRGBSurface(SDL_SWSURFACE, BACKGROUND565_W, BACKGROUND565_H, 16, 0xf800, 0x07e0, 0x001f, 0);
+	if (bg && rle565_decode(background565, sizeof(background565) / 2, (uint16_t *)bg->pixels, bg->w, bg->h, bg->pitch) < 0) {
+		SDL_FreeSurface(bg);
+		bg = NULL;
+	}
+	if (!bg) {
+		printf("background: %s\n", SDL_GetError());
+	}
+
+#ifndef RETROFW_HEADLESS
+	const char *input = getenv("RETROFW_INPUT");
+	if ((input == NULL || strcmp(input, "sdl")) && evdev_open() > 0) {
+		evdev_ui = true;
+		keys = boot_keys;
+	}
+#endif
+
+	const char *script = getenv("RETROFW_REPLAY");
+	if (script != NULL) {
+		if (replay_open(script, getenv("RETROFW_REPLAY_FAST") != NULL) == 0) {
+			// only the script presses keys
+			memset(boot_keys, 0, sizeof(boot_keys));
+			keys = boot_keys;
+		} else {
+			printf("%s: not an input script\n", script);
+		}
+	}
+	script = getenv("RETROFW_RECORD");
+	if (script != NULL && replay_record(script) < 0) printf("%s: could not record\n", script);
+}
+
+#ifdef RETROFW_HEADLESS
+#define RENDER_JOBS	2	// job screens of render_jobs()
+
+// Jobs in every row state with fixed numbers: one done, one running at 45%
+// with rate and ETA, one queued. done finishes them all before a reboot.
+int render_jobs(bool done) {
+	static const char *names[] = { "Check ext", "Check int", "Reset" };
+	memset(jobs, 0, sizeof(jobs));
+	for (int i = 0; i < 3; i++) {
+		jobs[i].name = names[i];
+		jobs[i].state = done || i == 0 ? JOB_FINISHED : i == 1 ? JOB_RUNNING : JOB_QUEUED;
+		jobs[i].phase = jobs[i].state == JOB_FINISHED ? "Done" : jobs[i].state == JOB_RUNNING ? "Checking files" : "Queued";
+		jobs[i].ms = 83000 + i * 21000;
+	}
+	jobs[1].tool = !done;
+	jobs[1].progress.total = 1000000000;
+	jobs[1].progress.done = 450000000;
+	jobs[1].progress.rate = 7400000;
+
+	job_count = 3;
+	jobs_left = done ? 0 : 2;
+	ui.ms = 125000;
+	ui.reboot = done;
+	int y = draw_jobs();
+
+	job_count = jobs_left = 0;
+	ui.reboot = false;
+	return y;
+}
+
+// Every distinct screen: the menu with each selection, the static ones,
+// then the jobs screen
+int render_screen(int i, char *name, size_t len) {
+	int row_y[sizeof(cb_map) / sizeof(cb_map[0]) + 1];
+	if (i < cb_size) {
+		snprintf(name, len, "menu_%d", i);
+		return draw_menu(i, row_y);
+	}
+	if (i < cb_size + SCREEN_COUNT) {
+		snprintf(name, len, "%s", screens[i - cb_size].name);
+		return draw_static(i - cb_size);
+	}
+	bool done = i - cb_size - SCREEN_COUNT > 0;
+	snprintf(name, len, "%s", done ? "jobs_done" : "jobs");
+	return render_jobs(done);
+}
+
+// Prints the named static screens as src/screens565.h
+int rle565_screens(FILE *f, int n, char *names[]) {
+	int ids[SCREEN_COUNT], count = 0;
+	char var[32];
+
+	build_stamp = false; // the baked screens outlive the build that rendered them
+	fprintf(f, "// generated by 'retrofw render rle565', do not edit\n\n#include <stddef.h>\n#include <stdint.h>\n\n");
+	fprintf(f, "#define SCREENS565_W %d\n#define SCREENS565_H %d\n\n", WIDTH, HEIGHT);
+
+	for (int i = 0; i < n; i++) {
+		int id = 0;
+		while (id < SCREEN_COUNT && strcmp(screens[id].name, names[i])) id++;
+		if (id == SCREEN_COUNT || count == SCREEN_COUNT) {
+			fprintf(stderr, "%s: no such screen\n", names[i]);
+			return 1;
+		}
+
+		draw_static(id);
+		snprintf(var, sizeof(var), "screen565_%s", names[i]);
+		int words = rle565_print(f, var, (uint16_t *)screen->pixels, WIDTH, HEIGHT, screen->pitch);
+		if (words < 0) return 1;
+		fprintf(stderr, "%s: %d bytes as RLE565\n", names[i], words * 2);
+		ids[count++] = id;
+	}
+
+	// indexed by enum screens
+	fprintf(f, "const struct { const uint16_t *rle; uint32_t words; } screens565[%d] = {\n", SCREEN_COUNT);
+	for (int id = 0; id < SCREEN_COUNT; id++) {
+		int i = 0;
+		while (i < count && ids[i] != id) i++;
+		if (i < count) fprintf(f, "\t{ screen565_%s, sizeof(screen565_%s) / 2 },\n", screens[id].name, screens[id].name);
+		else fprintf(f, "\t{ NULL, 0 },\t// %s\n", screens[id].name);
+	}
+	fprintf(f, "};\n");
+	return 0;
+}
+
+// Writes them to path through a temporary file, a failed run leaves the
+// previous header alone
+int render_rle565(const char *path, int n, char *names[]) {
+	char tmp[256];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *f = fopen(tmp, "w");
+	if (f == NULL) {
+		fprintf(stderr, "%s: could not write\n", tmp);
+		return 1;
+	}
+
+	int ret = rle565_screens(f, n, names);
+	if (ferror(f)) ret = 1;
+	if (fclose(f) != 0) ret = 1;
+	if (ret == 0 && rename(tmp, path) == 0) return 0;
+
+	fprintf(stderr, "%s: not written\n", path);
+	unlink(tmp);
+	return 1;
+}
+
+// retrofw render dump|check <dir>, retrofw render bench [frames],
+// retrofw render rle565 <header> <screen>...
+int render(int argc, char *argv[]) {
+	const char *cmd = argc > 2 ? argv[2] : "";
+	bool bench = !strcmp(cmd, "bench");
+	if (!bench && (argc < 4 || (strcmp(cmd, "dump") && strcmp(cmd, "check") && strcmp(cmd, "rle565")))) {
+		printf("usage: %s render dump|check <dir>\n       %s render bench [frames]\n       %s render rle565 <header> <screen>...\n", argv[0], argv[0], argv[0]);
+		return 1;
+	}
+
+	ui_init();
+	if (screen == NULL) return 1;
+	if (!strcmp(cmd, "rle565")) return render_rle565(argv[3], argc - 4, argv + 4);
+
+	int frames = bench && argc > 3 ? atoi(argv[3]) : RENDER_FRAMES, failed = 0;
+	uint64_t total = 0;
+	char name[32], path[256];
+
+	for (int i = 0; i < cb_size + SCREEN_COUNT + RENDER_JOBS; i++) {
+		uint16_t *px = (uint16_t *)screen->pixels;
+
+		if (bench) {
+			uint64_t t = render_now_ns();
+			for (int f = 0; f < frames; f++)
+				render_screen(i, name, sizeof(name));
+			t = render_now_ns() - t;
+			total += t;
+			printf("%-16s %10.1f fps\n", name, frames * 1e9 / t);
+			continue;
+		}
+
+		render_screen(i, name, sizeof(name));
+		snprintf(path, sizeof(path), "%s/%s.ppm", argv[3], name);
+		if (!strcmp(cmd, "dump")) {
+			if (ppm_write(path, px, WIDTH, HEIGHT, screen->pitch) < 0) {
+				printf("%s: write failed\n", path);
+				failed = 1;
+			}
+		} else {
+			int diff = ppm_compare(path, px, WIDTH, HEIGHT, screen->pitch);
+			if (diff) {
+				diff < 0 ? printf("%s: unreadable\n", path) : printf("%s: %d pixels differ\n", path, diff);
+				failed = 1;
+			}
+		}
+	}
+
+	if (bench) {
+		struct text_cache_stats_t tc;
+		text_cache_stats(&tc);
+		printf("%-16s %10.1f fps\n", "all", (double)frames * (cb_size + SCREEN_COUNT + RENDER_JOBS) * 1e9 / total);
+		printf("text cache: %u hits, %u misses, %u evictions\n", tc.hits, tc.misses, tc.evictions);
+	}
+	return failed;
+}
+#endif
 
 int main(int argc, char* argv[]) {
 	// keys = SDL_GetKeyState(NULL);
+	trace_init();
 
-	init_date_time();
+	if (argc > 1 && !strcmp(argv[1], "rtc")) {
+		rtc_report();
+		return 0;
+	} else if (argc > 1 && !strcmp(argv[1], "boottrace")) {
+		trace_report(argc > 2 ? atoi(argv[2]) : BOOTTRACE_SLOTS);
+		return 0;
+	} else if (argc > 2 && !strcmp(argv[1], "release")) {
+		// retrofw release <device pattern> [kill]
+		return mnt_release(argv[2], argc > 3 && !strcmp(argv[3], "kill"));
+	} else if (argc > 1 && !strcmp(argv[1], "mountall")) {
+		return mnt_mount_all();
+	} else if (argc > 1 && !strcmp(argv[1], "prefetch")) {
+		if (argc > 2 && !strcmp(argv[2], "reset")) unlink(ROOT(PREFETCH_FILE));
+		prefetch_report();
+		return 0;
+#ifdef RETROFW_HEADLESS
+	} else if (argc > 1 && !strcmp(argv[1], "render")) {
+		return render(argc, argv);
+#endif
+	} else if (argc > 2 && !strcmp(argv[1], "progress")) {
+		// retrofw progress fsck|mkfs < captured log
+		progress_report(strcmp(argv[2], "mkfs") ? PROGRESS_FSCK : PROGRESS_MKFS, stdin);
+		return 0;
+	} else if (argc > 1 && !strcmp(argv[1], "input")) {
+		// retrofw input [frame ms] [seconds], 50 ms reads like the frame-polled SDL path
+		return evdev_report(argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? atoi(argv[3]) : 10);
+	} else if (argc > 2 && !strcmp(argv[1], "replay")) {
+		// retrofw replay <script>
+		return replay_dump(argv[2]);
+	} else if (argc > 1 && !strcmp(argv[1], "intent")) {
+		// retrofw intent [resize|defl|fsck [ext]]
+		intent_load(&intents);
+		if (argc > 2) {
+			int op = OP_NONE;
+			if (!strcmp(argv[2], "resize")) op = OP_RESIZE;
+			else if (!strcmp(argv[2], "defl")) op = OP_DEFL;
+			else if (!strcmp(argv[2], "fsck")) op = OP_FSCK;
+
+			uint32_t param = (argc > 3 && !strcmp(argv[3], "ext")) ? FSCK_EXTERNAL : 0;
+			if (op == OP_NONE || intent_add(&intents, op, param) < 0 || intent_save(&intents) < 0) {
+				printf("Could not queue '%s'\n", argv[2]);
+				return 1;
+			}
+		}
+		intent_report(&intents);
+		return 0;
+	}
 
+	// before init_date_time(), which would set the system clock from the
+	// RTC and leave no drift to measure
 	if (argc > 1 && !strcmp(argv[1], "stop")) {
-		system("hwclock --systohc");
+#if defined(TARGET_RETROFW)
+		rtc_systohc();
+#endif
 		return 0;
 	}
 
+	trace_begin(TRACE_DATE_TIME);
+	init_date_time();
+	trace_end(TRACE_DATE_TIME);
+
 #ifdef TARGET_RETROFW
 	if (!file_exists("/dev/mmcblk1")) {
 		for (int i = 4; i < cb_size - 1; i++)
@@ -513,12 +1634,16 @@ int main(int argc, char* argv[]) {
 		setenv("SDL_AUDIODRIVER", "alsa", 1);
 	}
 
+	trace_begin(TRACE_CHECK_PART);
 	int mode = check_part();
+	trace_end(TRACE_CHECK_PART);
 
 	if (mode == MODE_START && argc > 1) {
 		if (!strcmp(argv[1], "network")) {
 			if (argc > 2 && !strcmp(argv[2], "on")) {
-				system("rmmod g_file_storage; modprobe g_ether; ifup usb0");
+				run("rmmod", "g_file_storage", NULL);
+				run("modprobe", "g_ether", NULL);
+				run("ifup", "usb0", NULL);
 			} else {
 				network_ascii();
 			}
@@ -529,9 +1654,11 @@ int main(int argc, char* argv[]) {
 		} else if (!strcmp(argv[1], "storage")) {
 			mode = MODE_UDC;
 		} else if (!strcmp(argv[1], "fatresize")) {
-			mode == MODE_RESIZE;
+			intent_add(&intents, OP_RESIZE, 0);
+			mode = MODE_RESIZE;
 		} else if (!strcmp(argv[1], "fsck")) {
-			mode == MODE_FSCK;
+			intent_add(&intents, OP_FSCK, FSCK_EXTERNAL);
+			mode = MODE_FSCK;
 		} else if (!strcmp(argv[1], "menu")) {
 			mode = MODE_MENU;
 		}
@@ -539,27 +1666,18 @@ int main(int argc, char* argv[]) {
 
 	cls();
 
-	int memdev = open("/dev/mem", O_RDWR);
-	if (memdev > 0) {
-		uint32_t *mem = (uint32_t*)mmap(0, 2048, PROT_READ | PROT_WRITE, MAP_SHARED, memdev, GPIO_BASE);
-		keys[BTN_A] = !(mem[PDPIN] >> 22 & 0b1); /* A */
-		keys[BTN_B] = !(mem[PDPIN] >> 23 & 0b1); /* B */
-		keys[BTN_X] = !(mem[PEPIN] >> 07 & 0b1); /* X */
-		keys[BTN_Y] = !(mem[PEPIN] >> 11 & 0b1); /* Y */
-		keys[BTN_L] = !(mem[PBPIN] >> 23 & 0b1); /* L */
-		keys[BTN_R] = !(mem[PDPIN] >> 24 & 0b1); /* R */
-		keys[BTN_SELECT]    =  (mem[PDPIN] >> 17 & 0b1); /* SELECT */
-		keys[BTN_START]     =  (mem[PDPIN] >> 18 & 0b1); /* START */
-		keys[BTN_BACKLIGHT] = !(mem[PDPIN] >> 21 & 0b1); /* BACKLIGHT */
-		keys[BTN_POWER]     = !(mem[PAPIN] >> 30 & 0b1); /* POWER */
-		keys[BTN_UP]        = !(mem[PBPIN] >> 25 & 0b1); /* UP */
-		keys[BTN_DOWN]      = !(mem[PBPIN] >> 24 & 0b1); /* DOWN */
-		keys[BTN_LEFT]      = !(mem[PDPIN] >> 00 & 0b1); /* LEFT */
-		keys[BTN_RIGHT]     = !(mem[PBPIN] >> 26 & 0b1); /* RIGHT */
-		munmap(mem, 2048);
-		close(memdev);
-	} else {
+	if (mode == MODE_FSCK) splash(SCREEN_FSCK);
+	else if (mode == MODE_DEFL) splash(SCREEN_DEFL);
+	else if (mode == MODE_RESIZE) splash(SCREEN_RESIZE);
+
+	trace_begin(TRACE_GPIO);
+	int gpio = gpio_read_keys(keys);
+	trace_end(TRACE_GPIO);
+
+	if (gpio < 0) {
+		trace_begin(TRACE_UI_INIT);
 		sdl_init();
+		trace_end(TRACE_UI_INIT);
 	}
 
 	if (keys[BTN_POWER] == SDL_PRESSED || keys[BTN_SELECT] == SDL_PRESSED) {
@@ -572,19 +1690,39 @@ int main(int argc, char* argv[]) {
 	}
 
 	if (mode == MODE_START) { // if mode is still MODE_START...
-		SDL_Quit();
+		if (sdl_loaded()) SDL_Quit();
 
-		if (file_exists("/root/swap.img") || file_exists("/root/local/swap.img")) {
-			system("swapon /root/swap.img /root/local/swap.img");
+		trace_begin(TRACE_SWAPON);
+#ifdef TARGET_RETROFW
+		zram_init();
+		if (file_exists("/root/swap.img")) swap_on(ROOT("/root/swap.img"), SWAP_SD_PRIO);
+		if (file_exists("/root/local/swap.img")) swap_on(ROOT("/root/local/swap.img"), SWAP_SD_PRIO);
+#endif
+		trace_end(TRACE_SWAPON);
+
+		trace_save(mode);
+
+		if (file_exists("/media/mmcblk1p1/autoexec.sh")) {
+			prefetch_start(ROOT("/media/mmcblk1p1/autoexec.sh"));
+		} else if (file_exists("/home/retrofw/autoexec.sh")) {
+			prefetch_start(ROOT("/home/retrofw/autoexec.sh"));
+		} else if (file_exists("/usr/bin/gmenunx")) {
+			prefetch_start(ROOT("/usr/bin/gmenunx"));
+		} else {
+			prefetch_start(ROOT("/home/retrofw/apps/gmenu2x/gmenu2x"));
 		}
 
+		BENCH_MARK_EXEC();
+
 		if (file_exists("/media/mmcblk1p1/autoexec.sh")) {
-			execlp("/bin/sh", "/bin/sh", "-c", "source /media/mmcblk1p1/autoexec.sh", NULL);
+			snprintf(buf, sizeof(buf), "source %s", ROOT("/media/mmcblk1p1/autoexec.sh"));
+			execlp("/bin/sh", "/bin/sh", "-c", buf, NULL);
 		} else if (file_exists("/home/retrofw/autoexec.sh")) {
-			execlp("/bin/sh", "/bin/sh", "-c", "source /home/retrofw/autoexec.sh", NULL);
-		} else if (execlp("/usr/bin/gmenunx", "/usr/bin/gmenunx", NULL)) {
+			snprintf(buf, sizeof(buf), "source %s", ROOT("/home/retrofw/autoexec.sh"));
+			execlp("/bin/sh", "/bin/sh", "-c", buf, NULL);
+		} else if (execlp(ROOT("/usr/bin/gmenunx"), "/usr/bin/gmenunx", NULL)) {
 			// gmenunx start
-		} else if (execlp("/home/retrofw/apps/gmenu2x/gmenu2x", "/home/retrofw/apps/gmenu2x/gmenu2x", NULL)) {
+		} else if (execlp(ROOT("/home/retrofw/apps/gmenu2x/gmenu2x"), "/home/retrofw/apps/gmenu2x/gmenu2x", NULL)) {
 			// gmenu2x start
 		}
 
@@ -592,77 +1730,27 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}
 
-	sdl_init();
-
-	if (TTF_Init() == -1) {
-		printf("TTF_Init: %s\n", SDL_GetError());
-		return -1;
-	}
-
-	font = TTF_OpenFontRW(SDL_RWFromMem(rwfont, sizeof(rwfont)), 1, 12);
-	TTF_SetFontHinting(font, TTF_HINTING_NORMAL);
-	TTF_SetFontOutline(font, 0);
-
-	bg = IMG_Load_RW(SDL_RWFromMem(background, sizeof(background)), 1);
-	if(!bg) {
-		printf("IMG_Load_RW: %s\n", SDL_GetError());
-	}
+	trace_begin(TRACE_UI_INIT);
+	ui_init();
+	trace_end(TRACE_UI_INIT);
+	trace_save(mode);
 
 	switch (mode) {
 		case MODE_RESIZE:
-			fatresize();
-			break;
 		case MODE_FSCK:
-			fsck();
-		  break;
 		case MODE_DEFL:
-			format_int();
-		  break;
+			jobs_from_intents();
+			ui_enter(STATE_JOBS);
+			break;
 		case MODE_UDC:
+			ui.back = -1; // leaving USB mode leaves recovery
 			udc();
 			break;
-		case MODE_MENU:
-			goto mode_menu;
+		default:
+			ui_enter(STATE_MENU);
 			break;
 	}
-	stop(); quit(0); return 0; // run for all except mode_menu
-
-	mode_menu: /* jump */;
-
-	int selected = 0;
-	while (1) {
-		nextline = draw_screen("RECOVERY MODE", "A: SELECT");
-
-		for (int i = 0; i < cb_size; i++) {
-			SDL_Color selColor = txtColor;
-			if (selected == i) selColor = subTitleColor;
-			nextline = draw_text(10, nextline, cb_map[i].text, selColor);
-		}
-
-		SDL_Flip(screen);
-
-		if (SDL_WaitEvent(&event)) {
-			SDL_PumpEvents();
-
-			if (event.type == SDL_KEYDOWN) {
-				if (keys[BTN_UP]) {
-					selected--;
-					if (selected < 0) selected = cb_size - 1;
-				} else if (keys[BTN_DOWN]) {
-					selected++;
-					if (selected >= cb_size) selected = 0;
-				} else if (keys[BTN_LEFT]) {
-					selected = 0;
-				} else if (keys[BTN_RIGHT]) {
-					selected = cb_size - 1;
-				} else if (keys[BTN_A]) {
-					cb_map[selected].callback();
-				}
-			}
-		}
-	}
-
-	reboot();
+	ui_loop();
 
 	return 0;
 }
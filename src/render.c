@@ -0,0 +1,81 @@
+#include "render.h"
+
+#ifdef RETROFW_HEADLESS
+#include "rle565.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// 5 and 6 bit channels widened by repeating their top bits
+static void rgb888(uint16_t p, uint8_t *out) {
+	uint8_t r = p >> 11, g = p >> 5 & 0x3f, b = p & 0x1f;
+	out[0] = r << 3 | r >> 2;
+	out[1] = g << 2 | g >> 4;
+	out[2] = b << 3 | b >> 2;
+}
+
+int ppm_write(const char *path, const uint16_t *px, int w, int h, int pitch) {
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) return -1;
+
+	fprintf(f, "P6\n%d %d\n255\n", w, h);
+	uint8_t *row = (uint8_t *)malloc(w * 3);
+	for (int y = 0; y < h; y++) {
+		const uint16_t *src = (const uint16_t *)((const uint8_t *)px + y * pitch);
+		for (int x = 0; x < w; x++)
+			rgb888(src[x], row + x * 3);
+		fwrite(row, 3, w, f);
+	}
+	free(row);
+
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+int ppm_compare(const char *path, const uint16_t *px, int w, int h, int pitch) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) return -1;
+
+	int fw, fh, max;
+	if (fscanf(f, "P6 %d %d %d", &fw, &fh, &max) != 3 || fgetc(f) == EOF || fw != w || fh != h || max != 255) {
+		fclose(f);
+		return -1;
+	}
+
+	int diff = 0;
+	uint8_t *row = (uint8_t *)malloc(w * 3), expect[3];
+	for (int y = 0; y < h; y++) {
+		if (fread(row, 3, w, f) != (size_t)w) {
+			diff = -1;
+			break;
+		}
+		const uint16_t *src = (const uint16_t *)((const uint8_t *)px + y * pitch);
+		for (int x = 0; x < w; x++) {
+			rgb888(src[x], expect);
+			if (expect[0] != row[x * 3] || expect[1] != row[x * 3 + 1] || expect[2] != row[x * 3 + 2]) diff++;
+		}
+	}
+	free(row);
+	fclose(f);
+	return diff;
+}
+
+int rle565_print(FILE *f, const char *name, const uint16_t *px, int w, int h, int pitch) {
+	uint16_t *rle = (uint16_t *)malloc(2 * w * h * sizeof(uint16_t));
+	if (rle == NULL) return -1;
+
+	size_t words = rle565_encode(px, w, h, pitch, rle);
+	fprintf(f, "const uint16_t %s[%u] = {", name, (unsigned int)words);
+	for (size_t i = 0; i < words; i++)
+		fprintf(f, "%s0x%04x,", i % 12 ? " " : "\n\t", rle[i]);
+	fprintf(f, "\n};\n\n");
+
+	free(rle);
+	return (int)words;
+}
+
+uint64_t render_now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
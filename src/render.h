@@ -0,0 +1,29 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+// Headless rendering ('make render'). Built with RETROFW_HEADLESS, the UI
+// draws into an in-memory 320x240 RGB565 surface and 'retrofw render'
+// dumps every screen to PPM, compares them with an earlier dump or times
+// them, all on the build host. 'retrofw render rle565' bakes screens into
+// the target binary (src/screens565.h). Regular builds compile this away.
+
+#ifdef RETROFW_HEADLESS
+	#include <stdint.h>
+	#include <stdio.h>
+
+	#define RENDER_FRAMES	2000
+
+	// Writes a w x h RGB565 image with pitch bytes per row as binary PPM
+	int ppm_write(const char *path, const uint16_t *px, int w, int h, int pitch);
+
+	// Number of pixels that differ from a PPM written by ppm_write(), -1 if
+	// it can't be read or has another size
+	int ppm_compare(const char *path, const uint16_t *px, int w, int h, int pitch);
+
+	// Prints an RGB565 image as a const RLE565 array, see src/rle565.h
+	int rle565_print(FILE *f, const char *name, const uint16_t *px, int w, int h, int pitch);
+
+	uint64_t render_now_ns();
+#endif
+
+#endif
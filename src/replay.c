@@ -0,0 +1,192 @@
+#include "replay.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct replay_header_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+};
+
+static struct {
+	int fd;				// script being recorded, -1 if none
+	uint32_t last_ms;	// of the last recorded event
+
+	int mode;
+	uint32_t *events;
+	int count, next;
+	uint64_t due_us;	// of the last event sent, 0 before the first frame
+	bool sent;			// in this frame
+	struct replay_event_t last;
+
+	uint64_t start_us, frame_us;
+	uint32_t frames, key_frames, key_max;
+	uint64_t key_us, idle_us;
+} rp = { -1 };
+
+static uint64_t now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Words are little-endian like the RetroFW, whatever the host is
+static void put_le32(uint8_t *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void decode(uint32_t word, struct replay_event_t *e) {
+	e->ms = word >> (REPLAY_KEY_BITS + 1);
+	e->state = word >> REPLAY_KEY_BITS & 1;
+	e->key = word & ((1 << REPLAY_KEY_BITS) - 1);
+}
+
+int replay_record(const char *path) {
+	rp.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (rp.fd < 0) return -1;
+
+	uint8_t header[sizeof(struct replay_header_t)];
+	memset(header, 0, sizeof(header));
+	put_le32(header, REPLAY_MAGIC);
+	header[4] = REPLAY_VERSION;
+	if (write(rp.fd, header, sizeof(header)) != sizeof(header)) {
+		close(rp.fd);
+		rp.fd = -1;
+		return -1;
+	}
+
+	rp.last_ms = now_us() / 1000;
+	return 0;
+}
+
+void replay_write(uint16_t key, uint8_t state) {
+	if (rp.fd < 0) return;
+
+	// unbuffered, a script ends where the device was powered off
+	uint32_t now = now_us() / 1000, ms = now - rp.last_ms;
+	if (ms > REPLAY_MS_MAX) ms = REPLAY_MS_MAX;
+	rp.last_ms = now;
+
+	uint8_t word[4];
+	put_le32(word, ms << (REPLAY_KEY_BITS + 1) | (uint32_t)!!state << REPLAY_KEY_BITS | (key & ((1 << REPLAY_KEY_BITS) - 1)));
+	if (write(rp.fd, word, sizeof(word)) != sizeof(word)) {
+		close(rp.fd);
+		rp.fd = -1;
+	}
+}
+
+int replay_open(const char *path, bool fast) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) return -1;
+
+	uint8_t header[sizeof(struct replay_header_t)];
+	uint32_t *events = (uint32_t *)malloc(REPLAY_MAX * sizeof(uint32_t));
+	int count = 0;
+	uint8_t word[4];
+
+	if (events == NULL || fread(header, sizeof(header), 1, f) != 1 ||
+		get_le32(header) != REPLAY_MAGIC || header[4] != REPLAY_VERSION) {
+		fclose(f);
+		free(events);
+		return -1;
+	}
+	while (count < REPLAY_MAX && fread(word, sizeof(word), 1, f) == 1)
+		events[count++] = get_le32(word);
+	fclose(f);
+
+	free(rp.events);
+	rp.events = events;
+	rp.count = count;
+	rp.next = 0;
+	rp.due_us = 0;
+	rp.mode = fast ? REPLAY_FAST : REPLAY_TIMED;
+	return 0;
+}
+
+int replay_mode() {
+	return rp.mode;
+}
+
+bool replay_next(struct replay_event_t *e) {
+	if (rp.mode == REPLAY_OFF || rp.next >= rp.count) return false;
+	if (rp.sent && rp.mode == REPLAY_FAST) return false;
+
+	struct replay_event_t next;
+	decode(rp.events[rp.next], &next);
+
+	// timed events count from the first frame, not from the start of SDL
+	uint64_t now = now_us();
+	if (!rp.due_us) rp.due_us = now;
+	if (rp.mode == REPLAY_TIMED) {
+		if (now < rp.due_us + (uint64_t)next.ms * 1000) return false;
+		rp.due_us += (uint64_t)next.ms * 1000;
+	}
+
+	rp.next++;
+	rp.sent = true;
+	rp.last = next;
+	*e = next;
+	return true;
+}
+
+void replay_frame_begin() {
+	if (rp.mode == REPLAY_OFF) return;
+	rp.frame_us = now_us();
+	if (!rp.start_us) rp.start_us = rp.frame_us;
+}
+
+bool replay_frame_end(int keys) {
+	if (rp.mode == REPLAY_OFF) return false;
+
+	uint64_t now = now_us();
+	uint32_t us = now - rp.frame_us;
+	rp.frames++;
+	if (keys) {
+		rp.key_frames++;
+		rp.key_us += us;
+		if (us > rp.key_max) rp.key_max = us;
+		printf("frame %6u %9.1f ms  key %3u %-4s %7u us\n", rp.frames, (now - rp.start_us) / 1000.0,
+			rp.last.key, rp.last.state ? "down" : "up", us);
+	} else {
+		rp.idle_us += us;
+	}
+	rp.sent = false;
+
+	return rp.next >= rp.count;
+}
+
+void replay_report() {
+	uint32_t idle = rp.frames - rp.key_frames;
+	printf("%d events in %u frames, %.1f ms\n", rp.count, rp.frames, (now_us() - rp.start_us) / 1000.0);
+	printf("frames with keys: %u, avg %u us, max %u us\n", rp.key_frames,
+		rp.key_frames ? (uint32_t)(rp.key_us / rp.key_frames) : 0, rp.key_max);
+	printf("idle frames: %u, avg %u us\n", idle, idle ? (uint32_t)(rp.idle_us / idle) : 0);
+}
+
+int replay_dump(const char *path) {
+	if (replay_open(path, false) < 0) {
+		printf("%s: not an input script\n", path);
+		return 1;
+	}
+
+	uint32_t t = 0;
+	printf("%5s %10s %5s %s\n", "event", "ms", "key", "state");
+	for (int i = 0; i < rp.count; i++) {
+		struct replay_event_t e;
+		decode(rp.events[i], &e);
+		t += e.ms;
+		printf("%5d %10u %5u %s\n", i, t, e.key, e.state ? "down" : "up");
+	}
+	return 0;
+}
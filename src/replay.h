@@ -0,0 +1,52 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+// Input scripts for repeatable UI benchmarks. RETROFW_RECORD=<file> writes
+// every key event the UI loop handles, RETROFW_REPLAY=<file> feeds them back
+// through the same loop instead of the keypad, RETROFW_REPLAY_FAST=1 without
+// the recorded pauses, one event per frame. A replay prints the time of
+// every frame that handled a key and a summary, then quits.
+//
+// A script is a header and one little-endian 32-bit word per event: the
+// milliseconds since the previous event, the key state and the SDL key.
+
+#define REPLAY_MAGIC	0x504e4952 // "RINP"
+#define REPLAY_VERSION	1
+#define REPLAY_MAX		4096		// events of a script
+
+#define REPLAY_KEY_BITS	9			// SDLK_LAST is 323
+#define REPLAY_MS_MAX	((1u << (31 - REPLAY_KEY_BITS)) - 1)
+
+struct replay_event_t {
+	uint32_t ms;	// since the previous event
+	uint16_t key;
+	uint8_t state;
+};
+
+int replay_record(const char *path);
+void replay_write(uint16_t key, uint8_t state);
+
+enum replay_modes {
+	REPLAY_OFF,
+	REPLAY_TIMED,	// events at their recorded times
+	REPLAY_FAST,
+};
+
+// Loads a script, 0 on success
+int replay_open(const char *path, bool fast);
+int replay_mode();
+
+// The next event once it is due, in fast mode one per frame
+bool replay_next(struct replay_event_t *e);
+
+// Around every frame of the UI loop, end returns true once the script is over
+void replay_frame_begin();
+bool replay_frame_end(int keys);
+void replay_report();
+
+// Prints the events of a script
+int replay_dump(const char *path);
+
+#endif
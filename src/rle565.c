@@ -0,0 +1,54 @@
+#include "rle565.h"
+
+int rle565_decode(const uint16_t *rle, size_t words, uint16_t *out, int w, int h, int pitch) {
+	int x = 0, y = 0;
+	uint16_t *row = out;
+
+	for (size_t i = 0; i + 1 < words; i += 2) {
+		uint32_t n = rle[i];
+		uint16_t color = rle[i + 1];
+
+		while (n) {
+			if (y >= h) return -1;
+
+			uint32_t span = (uint32_t)(w - x) < n ? w - x : n;
+			for (uint32_t j = 0; j < span; j++)
+				row[x + j] = color;
+
+			x += span;
+			n -= span;
+			if (x == w) {
+				x = 0;
+				y++;
+				row = (uint16_t *)((uint8_t *)row + pitch);
+			}
+		}
+	}
+
+	return (y == h && x == 0) ? 0 : -1;
+}
+
+size_t rle565_encode(const uint16_t *px, int w, int h, int pitch, uint16_t *out) {
+	size_t words = 0;
+	uint32_t n = 0;
+	uint16_t color = 0;
+
+	// runs of (count, color), count up to 0xffff, across rows
+	for (int y = 0; y < h; y++) {
+		const uint16_t *row = (const uint16_t *)((const uint8_t *)px + y * pitch);
+		for (int x = 0; x < w; x++) {
+			if (n && (row[x] != color || n == 0xffff)) {
+				out[words++] = n;
+				out[words++] = color;
+				n = 0;
+			}
+			color = row[x];
+			n++;
+		}
+	}
+	if (n) {
+		out[words++] = n;
+		out[words++] = color;
+	}
+	return words;
+}
@@ -0,0 +1,19 @@
+#ifndef RLE565_H
+#define RLE565_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Run length encoded RGB565 images, as (count, color) pairs of 16 bit
+// words in row major order. Generated at build time by src/png2rle565.c
+// and by 'retrofw render rle565'.
+
+// Expands rle into a w x h image with pitch bytes per row. Returns -1 if
+// the runs don't cover exactly w * h pixels.
+int rle565_decode(const uint16_t *rle, size_t words, uint16_t *out, int w, int h, int pitch);
+
+// Encodes a w x h image with pitch bytes per row into out, which must have
+// room for 2 * w * h words. Returns the number of words written.
+size_t rle565_encode(const uint16_t *px, int w, int h, int pitch, uint16_t *out);
+
+#endif
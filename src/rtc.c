@@ -0,0 +1,117 @@
+#include "rtc.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/rtc.h>
+
+const char *rtc_dev() {
+	const char *dev = getenv("RTC_DEV");
+	return (dev != NULL && *dev) ? dev : ROOT(RTC_DEV);
+}
+
+int rtc_read(time_t *t) {
+	int fd = open(rtc_dev(), O_RDONLY);
+	if (fd < 0) return -1;
+
+	struct rtc_time rt;
+	memset(&rt, 0, sizeof(rt));
+	int ret = ioctl(fd, RTC_RD_TIME, &rt);
+	close(fd);
+	if (ret < 0) return -1;
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_sec = rt.tm_sec;
+	tm.tm_min = rt.tm_min;
+	tm.tm_hour = rt.tm_hour;
+	tm.tm_mday = rt.tm_mday;
+	tm.tm_mon = rt.tm_mon;
+	tm.tm_year = rt.tm_year;
+
+	*t = timegm(&tm);
+	return *t == (time_t)-1 ? -1 : 0;
+}
+
+int rtc_write(time_t t) {
+	struct tm tm;
+	if (gmtime_r(&t, &tm) == NULL) return -1;
+
+	struct rtc_time rt;
+	memset(&rt, 0, sizeof(rt));
+	rt.tm_sec = tm.tm_sec;
+	rt.tm_min = tm.tm_min;
+	rt.tm_hour = tm.tm_hour;
+	rt.tm_mday = tm.tm_mday;
+	rt.tm_mon = tm.tm_mon;
+	rt.tm_year = tm.tm_year;
+	rt.tm_wday = tm.tm_wday;
+	rt.tm_yday = tm.tm_yday;
+
+	int fd = open(rtc_dev(), O_RDONLY);
+	if (fd < 0) return -1;
+	int ret = ioctl(fd, RTC_SET_TIME, &rt);
+	close(fd);
+	return ret < 0 ? -1 : 0;
+}
+
+static long uptime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+int rtc_systohc() {
+	time_t now = time(0);
+	time_t rtc;
+
+	if (rtc_read(&rtc) == 0) {
+		FILE *f = fopen(ROOT(RTC_DRIFT_FILE), "w");
+		if (f != NULL) {
+			fprintf(f, "%ld %ld %ld\n", (long)now, (long)(now - rtc), uptime());
+			fclose(f);
+		}
+	}
+
+	return rtc_write(now);
+}
+
+int rtc_drift_load(struct rtc_drift_t *drift) {
+	FILE *f = fopen(ROOT(RTC_DRIFT_FILE), "r");
+	if (f == NULL) return -1;
+
+	long measured;
+	int n = fscanf(f, "%ld %ld %ld", &measured, &drift->offset, &drift->uptime);
+	fclose(f);
+	drift->measured = measured;
+	return n == 3 ? 0 : -1;
+}
+
+void rtc_report() {
+	time_t now = time(0);
+	time_t rtc;
+	char str[32];
+
+	strftime(str, sizeof(str), "%Y-%m-%d %H:%M:%S", gmtime(&now));
+	printf("system: %s UTC\n", str);
+
+	if (rtc_read(&rtc) == 0) {
+		strftime(str, sizeof(str), "%Y-%m-%d %H:%M:%S", gmtime(&rtc));
+		printf("rtc:    %s UTC (%s)\n", str, rtc_dev());
+		printf("offset: %+lds\n", (long)(now - rtc));
+	} else {
+		printf("rtc:    %s not readable\n", rtc_dev());
+	}
+
+	struct rtc_drift_t drift;
+	if (rtc_drift_load(&drift) == 0) {
+		strftime(str, sizeof(str), "%Y-%m-%d %H:%M:%S", gmtime(&drift.measured));
+		printf("last sync: %s UTC, offset %+lds after %lds", str, drift.offset, drift.uptime);
+		if (drift.uptime > 0)
+			printf(" (%+.1f ppm)", drift.offset * 1e6 / drift.uptime);
+		printf("\n");
+	}
+}
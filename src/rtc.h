@@ -0,0 +1,29 @@
+#ifndef RTC_H
+#define RTC_H
+
+#include <time.h>
+
+// Hardware clock access through the RTC_RD_TIME/RTC_SET_TIME ioctls, so
+// boot and shutdown don't have to fork hwclock. The RTC is kept in UTC.
+// The device can be overridden with the RTC_DEV environment variable.
+
+#define RTC_DEV			"/dev/rtc0"
+#define RTC_DRIFT_FILE	"/boot/.rtcdrift"
+
+struct rtc_drift_t {
+	time_t measured;	// system time of the measurement
+	long offset;		// system clock minus RTC, in seconds
+	long uptime;		// seconds the system clock ran since boot
+};
+
+const char *rtc_dev();
+int rtc_read(time_t *t);
+int rtc_write(time_t t);
+
+// Writes the system time to the RTC, recording the offset found first
+int rtc_systohc();
+
+int rtc_drift_load(struct rtc_drift_t *drift);
+void rtc_report();
+
+#endif
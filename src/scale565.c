@@ -0,0 +1,67 @@
+#include "scale565.h"
+#include <string.h>
+
+#ifdef SCALE565_SSE2
+	#include <emmintrin.h>
+#endif
+
+void scale565_row2x_scalar(uint16_t *dst, const uint16_t *src, int w) {
+	for (int i = 0; i < w; i++)
+		dst[2 * i] = dst[2 * i + 1] = src[i];
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	#define FIRST(w)	((w) >> 16)
+	#define SECOND(w)	((w) & 0xffff)
+#else
+	#define FIRST(w)	((w) & 0xffff)
+	#define SECOND(w)	((w) >> 16)
+#endif
+
+// A pair of source pixels in one load, each doubled into one store. dst is
+// word aligned whenever the row is, src may not be.
+void scale565_row2x_swar(uint16_t *dst, const uint16_t *src, int w) {
+	int i = 0;
+	for (; i + 2 <= w; i += 2) {
+		uint32_t p, a, b;
+		memcpy(&p, src + i, 4);
+		a = FIRST(p);
+		b = SECOND(p);
+		a |= a << 16;
+		b |= b << 16;
+		memcpy(dst + 2 * i, &a, 4);
+		memcpy(dst + 2 * i + 2, &b, 4);
+	}
+	if (i < w) dst[2 * i] = dst[2 * i + 1] = src[i];
+}
+
+#ifdef SCALE565_SSE2
+void scale565_row2x_sse2(uint16_t *dst, const uint16_t *src, int w) {
+	int i = 0;
+	for (; i + 8 <= w; i += 8) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi16(p, p));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i + 8), _mm_unpackhi_epi16(p, p));
+	}
+	scale565_row2x_scalar(dst + 2 * i, src + i, w - i);
+}
+#endif
+
+void scale565(uint16_t *dst, int dst_pitch, const uint16_t *src, int src_pitch, int w, int h, int factor) {
+	for (int y = 0; y < h; y++) {
+		const uint16_t *in = (const uint16_t *)((const uint8_t *)src + y * src_pitch);
+		uint16_t *out = (uint16_t *)((uint8_t *)dst + y * factor * dst_pitch);
+
+		if (factor == 1) {
+			memcpy(out, in, w * 2);
+			continue;
+		}
+
+#ifdef SCALE565_SSE2
+		scale565_row2x_sse2(out, in, w);
+#else
+		scale565_row2x_swar(out, in, w);
+#endif
+		memcpy((uint8_t *)out + dst_pitch, out, w * 4);
+	}
+}
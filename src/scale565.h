@@ -0,0 +1,27 @@
+#ifndef SCALE565_H
+#define SCALE565_H
+
+#include <stdint.h>
+
+// Integer nearest neighbor scaling of RGB565 images, used to present the
+// 320x240 canvas on larger panels. Every variant gives the same pixels:
+// SWAR for the MIPS32 target, SSE2 for host builds, which
+// 'make bench-scale' compares against the scalar reference.
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+	#define SCALE565_SSE2
+#endif
+
+// One row of w pixels widened to 2 * w
+typedef void (*scale565_row_fn)(uint16_t *dst, const uint16_t *src, int w);
+
+void scale565_row2x_scalar(uint16_t *dst, const uint16_t *src, int w);
+void scale565_row2x_swar(uint16_t *dst, const uint16_t *src, int w);
+#ifdef SCALE565_SSE2
+void scale565_row2x_sse2(uint16_t *dst, const uint16_t *src, int w);
+#endif
+
+// Scales a w x h block by factor 1 or 2, pitches are in bytes
+void scale565(uint16_t *dst, int dst_pitch, const uint16_t *src, int src_pitch, int w, int h, int factor);
+
+#endif
@@ -0,0 +1,40 @@
+#include "sdl_loader.h"
+#include <dlfcn.h>
+#include <stdio.h>
+
+struct sdl_loader_t sdl_dl;
+
+static const char *sdl_lib_names[LIB_COUNT] = {
+	SDL_LIB,
+};
+
+bool sdl_loaded() {
+	return sdl_dl.lib[LIB_SDL] != NULL;
+}
+
+bool sdl_load() {
+	if (sdl_loaded()) return true;
+
+	void *lib[LIB_COUNT];
+	for (int i = 0; i < LIB_COUNT; i++) {
+		lib[i] = dlopen(sdl_lib_names[i], RTLD_NOW | RTLD_GLOBAL);
+		if (lib[i] == NULL) {
+			printf("dlopen: %s\n", dlerror());
+			return false;
+		}
+	}
+
+#define SYM(l, ret, name, args) \
+	*(void **)(&sdl_dl.dl_##name) = dlsym(lib[l], #name); \
+	if (sdl_dl.dl_##name == NULL) { \
+		printf("dlsym: %s\n", dlerror()); \
+		return false; \
+	}
+	SDL_SYMBOLS
+#undef SYM
+
+	for (int i = 0; i < LIB_COUNT; i++)
+		sdl_dl.lib[i] = lib[i];
+
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef SDL_LOADER_H
+#define SDL_LOADER_H
+
+#include <SDL/SDL.h>
+
+// SDL is dlopen'ed only when a recovery screen is shown, so the normal
+// boot path execs the launcher with no graphics library mapped. Calls keep
+// their usual names through the macros below.
+
+#ifndef SDL_LIB
+	#define SDL_LIB			"libSDL-1.2.so.0"
+#endif
+
+enum sdl_libs {
+	LIB_SDL,
+	LIB_COUNT
+};
+
+#define SDL_SYMBOLS \
+	SYM(LIB_SDL, int, SDL_Init, (Uint32 flags)) \
+	SYM(LIB_SDL, void, SDL_Quit, (void)) \
+	SYM(LIB_SDL, char *, SDL_GetError, (void)) \
+	SYM(LIB_SDL, int, SDL_ShowCursor, (int toggle)) \
+	SYM(LIB_SDL, SDL_Surface *, SDL_SetVideoMode, (int width, int height, int bpp, Uint32 flags)) \
+	SYM(LIB_SDL, int, SDL_EnableKeyRepeat, (int delay, int interval)) \
+	SYM(LIB_SDL, void, SDL_PumpEvents, (void)) \
+	SYM(LIB_SDL, Uint8 *, SDL_GetKeyState, (int *numkeys)) \
+	SYM(LIB_SDL, int, SDL_PollEvent, (SDL_Event *event)) \
+	SYM(LIB_SDL, int, SDL_Flip, (SDL_Surface *screen)) \
+	SYM(LIB_SDL, void, SDL_UpdateRects, (SDL_Surface *screen, int numrects, SDL_Rect *rects)) \
+	SYM(LIB_SDL, int, SDL_UpperBlit, (SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect)) \
+	SYM(LIB_SDL, void, SDL_FreeSurface, (SDL_Surface *surface)) \
+	SYM(LIB_SDL, int, SDL_FillRect, (SDL_Surface *dst, SDL_Rect *dstrect, Uint32 color)) \
+	SYM(LIB_SDL, Uint32, SDL_MapRGB, (const SDL_PixelFormat * const format, const Uint8 r, const Uint8 g, const Uint8 b)) \
+	SYM(LIB_SDL, void, SDL_Delay, (Uint32 ms)) \
+	SYM(LIB_SDL, SDL_Surface *, SDL_CreateRGBSurface, (Uint32 flags, int width, int height, int depth, Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)) \
+	SYM(LIB_SDL, SDL_Surface *, SDL_CreateRGBSurfaceFrom, (void *pixels, int width, int height, int depth, int pitch, Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)) \
+	SYM(LIB_SDL, int, SDL_LockSurface, (SDL_Surface *surface)) \
+	SYM(LIB_SDL, void, SDL_UnlockSurface, (SDL_Surface *surface))
+
+struct sdl_loader_t {
+	void *lib[LIB_COUNT];
+#define SYM(lib, ret, name, args) ret (*dl_##name) args;
+	SDL_SYMBOLS
+#undef SYM
+};
+
+extern struct sdl_loader_t sdl_dl;
+
+bool sdl_load();
+bool sdl_loaded();
+
+#define SDL_Init				(*sdl_dl.dl_SDL_Init)
+#define SDL_Quit				(*sdl_dl.dl_SDL_Quit)
+#define SDL_GetError			(*sdl_dl.dl_SDL_GetError)
+#define SDL_ShowCursor			(*sdl_dl.dl_SDL_ShowCursor)
+#define SDL_SetVideoMode		(*sdl_dl.dl_SDL_SetVideoMode)
+#define SDL_EnableKeyRepeat		(*sdl_dl.dl_SDL_EnableKeyRepeat)
+#define SDL_PumpEvents			(*sdl_dl.dl_SDL_PumpEvents)
+#define SDL_GetKeyState			(*sdl_dl.dl_SDL_GetKeyState)
+#define SDL_PollEvent			(*sdl_dl.dl_SDL_PollEvent)
+#define SDL_Flip				(*sdl_dl.dl_SDL_Flip)
+#define SDL_UpdateRects			(*sdl_dl.dl_SDL_UpdateRects)
+#define SDL_UpperBlit			(*sdl_dl.dl_SDL_UpperBlit)
+#define SDL_FreeSurface			(*sdl_dl.dl_SDL_FreeSurface)
+#define SDL_FillRect			(*sdl_dl.dl_SDL_FillRect)
+#define SDL_MapRGB				(*sdl_dl.dl_SDL_MapRGB)
+#define SDL_Delay				(*sdl_dl.dl_SDL_Delay)
+#define SDL_CreateRGBSurface	(*sdl_dl.dl_SDL_CreateRGBSurface)
+#define SDL_CreateRGBSurfaceFrom	(*sdl_dl.dl_SDL_CreateRGBSurfaceFrom)
+#define SDL_LockSurface			(*sdl_dl.dl_SDL_LockSurface)
+#define SDL_UnlockSurface		(*sdl_dl.dl_SDL_UnlockSurface)
+
+#endif
@@ -0,0 +1,126 @@
+#include "swap.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/swap.h>
+
+static int sysfs_write(const char *attr, const char *value) {
+	char path[64];
+	snprintf(path, sizeof(path), ZRAM_SYS "/%s", attr);
+
+	int fd = open(ROOT(path), O_WRONLY);
+	if (fd < 0) return -1;
+	ssize_t len = write(fd, value, strlen(value));
+	close(fd);
+	return len < 0 ? -1 : 0;
+}
+
+static uint64_t sysfs_read(const char *attr) {
+	char path[64];
+	snprintf(path, sizeof(path), ZRAM_SYS "/%s", attr);
+
+	unsigned long long value = 0;
+	FILE *f = fopen(ROOT(path), "r");
+	if (f == NULL) return 0;
+	fscanf(f, "%llu", &value);
+	fclose(f);
+	return value;
+}
+
+static uint64_t mem_total() {
+	unsigned long kb = 0;
+	char line[128];
+
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f == NULL) return 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "MemTotal: %lu kB", &kb) == 1) break;
+	}
+	fclose(f);
+	return (uint64_t)kb * 1024;
+}
+
+// Same header mkswap writes: version 1, last page and the signature
+static int swap_mkheader(const char *dev, uint64_t size) {
+	long page = sysconf(_SC_PAGESIZE);
+	char *hdr = (char *)calloc(1, page);
+	if (hdr == NULL) return -1;
+
+	uint32_t version = 1, last_page = size / page - 1;
+	memcpy(hdr + 1024, &version, sizeof(version));
+	memcpy(hdr + 1028, &last_page, sizeof(last_page));
+	memcpy(hdr + page - 10, "SWAPSPACE2", 10);
+
+	int fd = open(dev, O_WRONLY);
+	ssize_t len = -1;
+	if (fd >= 0) {
+		len = write(fd, hdr, page);
+		close(fd);
+	}
+	free(hdr);
+	return len == page ? 0 : -1;
+}
+
+int swap_on(const char *path, int prio) {
+	int flags = SWAP_FLAG_PREFER | ((prio << SWAP_FLAG_PRIO_SHIFT) & SWAP_FLAG_PRIO_MASK);
+	return swapon(path, flags);
+}
+
+int zram_init() {
+	struct stat s;
+	if (stat(ROOT(ZRAM_SYS), &s) != 0) return -1;
+	if (sysfs_read("disksize") != 0) return 0; // already in use
+
+	uint64_t size = mem_total() * ZRAM_PERCENT / 100;
+	if (size == 0) return -1;
+
+	char value[24];
+	snprintf(value, sizeof(value), "%llu", (unsigned long long)size);
+
+	sysfs_write("comp_algorithm", ZRAM_ALGORITHM); // keeps the default (lzo) if unsupported
+	if (sysfs_write("disksize", value) < 0) return -1;
+	if (swap_mkheader(ROOT(ZRAM_DEV), size) < 0) return -1;
+	return swap_on(ROOT(ZRAM_DEV), ZRAM_PRIO);
+}
+
+int zram_stat(struct zram_stat_t *stat) {
+	memset(stat, 0, sizeof(*stat));
+	stat->disksize = sysfs_read("disksize");
+	if (!stat->disksize) return -1;
+
+	// mm_stat on newer kernels, one attribute per value on older ones
+	unsigned long long orig, compr, used;
+	FILE *f = fopen(ROOT(ZRAM_SYS "/mm_stat"), "r");
+	if (f != NULL && fscanf(f, "%llu %llu %llu", &orig, &compr, &used) == 3) {
+		stat->orig = orig;
+		stat->compr = compr;
+		stat->used = used;
+	} else {
+		stat->orig = sysfs_read("orig_data_size");
+		stat->compr = sysfs_read("compr_data_size");
+		stat->used = sysfs_read("mem_used_total");
+	}
+	if (f != NULL) fclose(f);
+
+	return 0;
+}
+
+int swap_list(struct swap_entry_t *entries, int max) {
+	FILE *f = fopen("/proc/swaps", "r");
+	if (f == NULL) return 0;
+
+	char line[256];
+	int count = 0;
+	fgets(line, sizeof(line), f); // header
+	while (count < max && fgets(line, sizeof(line), f)) {
+		struct swap_entry_t *e = &entries[count];
+		if (sscanf(line, "%63s %*s %ld %ld %d", e->name, &e->size, &e->used, &e->prio) == 4)
+			count++;
+	}
+	fclose(f);
+	return count;
+}
@@ -0,0 +1,41 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdint.h>
+
+// Compressed swap in RAM (zram) in front of the swap files on the SD card.
+// Both tiers are activated with swapon(2), zram at the higher priority so
+// the kernel only falls back to the card once zram is full.
+
+#define ZRAM_DEV		"/dev/zram0"
+#define ZRAM_SYS		"/sys/block/zram0"
+#define ZRAM_ALGORITHM	"lz4"
+#define ZRAM_PERCENT	50		// disksize as a share of MemTotal
+#define ZRAM_PRIO		100
+#define SWAP_SD_PRIO	10
+#define SWAP_MAX		8
+
+struct zram_stat_t {
+	uint64_t disksize;
+	uint64_t orig;		// uncompressed size of the data stored
+	uint64_t compr;		// compressed size
+	uint64_t used;		// memory used including allocator overhead
+};
+
+struct swap_entry_t {
+	char name[64];
+	long size;		// KiB
+	long used;		// KiB
+	int prio;
+};
+
+int swap_on(const char *path, int prio);
+
+// Sizes, formats and activates zram0 unless it's already set up
+int zram_init();
+int zram_stat(struct zram_stat_t *stat);
+
+// Active swap areas from /proc/swaps, returns the number of entries
+int swap_list(struct swap_entry_t *entries, int max);
+
+#endif
@@ -0,0 +1,102 @@
+#include "textcache.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct text_entry_t {
+	uint32_t hash;		// 0 marks a free slot
+	uint32_t used;		// LRU clock
+	uint32_t color;
+	int size;
+	char text[TEXT_CACHE_LEN];
+	struct atlas_mask_t mask;
+};
+
+static struct text_entry_t cache[TEXT_CACHE_ENTRIES];
+static struct text_cache_stats_t stats;
+static uint32_t lru_clock;
+
+static uint32_t text_hash(const char *text, uint32_t color, int size) {
+	uint32_t h = 2166136261u; // FNV-1a
+	for (const char *p = text; *p; p++)
+		h = (h ^ (uint8_t)*p) * 16777619u;
+	h = (h ^ color) * 16777619u;
+	h = (h ^ size) * 16777619u;
+	return h ? h : 1;
+}
+
+static uint32_t text_entry_bytes(const struct text_entry_t *e) {
+	return e->mask.w * e->mask.h;
+}
+
+static void text_entry_free(struct text_entry_t *e) {
+	if (e->hash) {
+		stats.entries--;
+		stats.bytes -= text_entry_bytes(e);
+	}
+	free(e->mask.data);
+	memset(e, 0, sizeof(*e));
+}
+
+static int text_blit(struct text_entry_t *e, SDL_Surface *dst, int x, int y, SDL_Color color) {
+	return atlas_blit(dst, x, y, &e->mask, color) < 0 ? -1 : e->mask.h;
+}
+
+int text_draw(SDL_Surface *dst, int x, int y, const char *text, SDL_Color color, int size) {
+	uint32_t rgb = color.r << 16 | color.g << 8 | color.b;
+
+	if (strlen(text) >= TEXT_CACHE_LEN) {
+		struct text_entry_t e;
+		memset(&e, 0, sizeof(e));
+		int h = atlas_render(text, &e.mask) < 0 ? -1 : text_blit(&e, dst, x, y, color);
+		text_entry_free(&e);
+		return h;
+	}
+
+	uint32_t hash = text_hash(text, rgb, size);
+	struct text_entry_t *lru = &cache[0];
+	lru_clock++;
+
+	for (int i = 0; i < TEXT_CACHE_ENTRIES; i++) {
+		struct text_entry_t *e = &cache[i];
+		if (e->hash == hash && e->color == rgb && e->size == size && !strcmp(e->text, text)) {
+			stats.hits++;
+			e->used = lru_clock;
+			return text_blit(e, dst, x, y, color);
+		}
+		if (!e->hash) {
+			if (lru->hash) lru = e;
+		} else if (lru->hash && e->used < lru->used) {
+			lru = e;
+		}
+	}
+
+	stats.misses++;
+	if (lru->hash) {
+		stats.evictions++;
+		text_entry_free(lru);
+	}
+
+	if (atlas_render(text, &lru->mask) < 0) {
+		text_entry_free(lru);
+		return -1;
+	}
+
+	lru->hash = hash;
+	lru->used = lru_clock;
+	lru->color = rgb;
+	lru->size = size;
+	strcpy(lru->text, text);
+	stats.entries++;
+	stats.bytes += text_entry_bytes(lru);
+
+	return text_blit(lru, dst, x, y, color);
+}
+
+void text_cache_flush() {
+	for (int i = 0; i < TEXT_CACHE_ENTRIES; i++)
+		text_entry_free(&cache[i]);
+}
+
+void text_cache_stats(struct text_cache_stats_t *out) {
+	*out = stats;
+}
@@ -0,0 +1,28 @@
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "sdl_loader.h"
+#include "atlas.h"
+
+// Rendered lines of text, keyed by (text, color, font size) and evicted
+// least recently used first. Most UI strings never change, so a redraw is
+// a blend of a ready mask from the glyph atlas.
+
+#define TEXT_CACHE_ENTRIES	48
+#define TEXT_CACHE_LEN		64	// longer lines are drawn uncached
+
+struct text_cache_stats_t {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t entries;
+	uint32_t bytes;
+};
+
+// Draws text with its line top at x, y. Returns the line height or -1.
+int text_draw(SDL_Surface *dst, int x, int y, const char *text, SDL_Color color, int size);
+
+void text_cache_flush();
+void text_cache_stats(struct text_cache_stats_t *stats);
+
+#endif
@@ -0,0 +1,106 @@
+// Host tool: rasterizes the printable ASCII range of the embedded UI font
+// (src/font.h) into the glyph atlas of src/atlas.h, so the device needs
+// neither SDL_ttf nor FreeType. Metrics, hinting and kerning follow
+// SDL_ttf 2.0 at TTF_HINTING_NORMAL, which the UI used to render with.
+//
+// usage: ttf2atlas <name> <size> > header.h
+
+#include <stdint.h>
+#include "font.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define FIRST	' '
+#define LAST	'~'
+
+#define FT_FLOOR(x)	(((x) & -64) / 64)
+#define FT_CEIL(x)	((((x) + 63) & -64) / 64)
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <name> <size>\n", argv[0]);
+		return 1;
+	}
+	const char *name = argv[1];
+	int size = atoi(argv[2]);
+
+	FT_Library lib;
+	FT_Face face;
+	if (FT_Init_FreeType(&lib) || FT_New_Memory_Face(lib, rwfont, sizeof(rwfont), 0, &face) ||
+		!FT_IS_SCALABLE(face) || FT_Set_Char_Size(face, 0, size * 64, 0, 0)) {
+		fprintf(stderr, "%s: cannot load font\n", name);
+		return 1;
+	}
+
+	FT_Fixed scale = face->size->metrics.y_scale;
+	int ascent = FT_CEIL(FT_MulFix(face->ascender, scale));
+	int descent = FT_CEIL(FT_MulFix(face->descender, scale));
+	int height = ascent - descent + 1;
+
+	char upper[64];
+	snprintf(upper, sizeof(upper), "%s", name);
+	for (char *c = upper; *c; c++)
+		if (*c >= 'a' && *c <= 'z') *c -= 'a' - 'A';
+
+	printf("// generated from src/font.h by src/ttf2atlas.c, do not edit\n\n");
+	printf("#define %s_SIZE %d\n#define %s_FIRST %d\n#define %s_LAST %d\n#define %s_HEIGHT %d\n\n",
+		upper, size, upper, FIRST, upper, LAST, upper, height);
+
+	// offset, w, h, minx, yoffset, advance
+	std::vector<uint8_t> coverage;
+	FT_UInt index[LAST - FIRST + 1];
+	printf("const struct atlas_glyph_t %s_glyphs[%d] = {\n", name, LAST - FIRST + 1);
+	for (int c = FIRST; c <= LAST; c++) {
+		index[c - FIRST] = FT_Get_Char_Index(face, c);
+		if (FT_Load_Glyph(face, index[c - FIRST], FT_LOAD_DEFAULT | FT_LOAD_TARGET_NORMAL) ||
+			FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL)) {
+			fprintf(stderr, "%s: cannot render '%c'\n", name, c);
+			return 1;
+		}
+
+		const FT_Glyph_Metrics *m = &face->glyph->metrics;
+		const FT_Bitmap *bmp = &face->glyph->bitmap;
+		int minx = FT_FLOOR(m->horiBearingX);
+		int maxy = FT_FLOOR(m->horiBearingY);
+		int advance = FT_CEIL(m->horiAdvance);
+
+		printf("\t{ %u, %u, %u, %d, %d, %d },\t// '%s%c'\n", (unsigned int)coverage.size(), bmp->width, bmp->rows,
+			minx, ascent - maxy, advance, c == '\\' ? "\\" : "", c);
+
+		for (unsigned int row = 0; row < bmp->rows; row++)
+			coverage.insert(coverage.end(), bmp->buffer + row * bmp->pitch, bmp->buffer + row * bmp->pitch + bmp->width);
+	}
+	printf("};\n\n");
+
+	printf("const uint8_t %s_coverage[%u] = {", name, (unsigned int)coverage.size());
+	for (size_t i = 0; i < coverage.size(); i++)
+		printf("%s0x%02x,", i % 16 ? " " : "\n\t", coverage[i]);
+	printf("\n};\n\n");
+
+	// only the non-zero pairs, sorted for a binary search
+	int pairs = 0;
+	printf("const struct atlas_kern_t %s_kerning[] = {\n", name);
+	for (int a = FIRST; a <= LAST && FT_HAS_KERNING(face); a++) {
+		for (int b = FIRST; b <= LAST; b++) {
+			FT_Vector delta;
+			if (!index[a - FIRST] || !index[b - FIRST]) continue;
+			if (FT_Get_Kerning(face, index[a - FIRST], index[b - FIRST], FT_KERNING_DEFAULT, &delta)) continue;
+			if (delta.x >> 6 == 0) continue;
+			printf("\t{ %d, %d, %ld },\n", a, b, delta.x >> 6);
+			pairs++;
+		}
+	}
+	if (!pairs) printf("\t{ 0, 0, 0 },\n"); // no empty arrays, the count below stays 0
+	printf("};\n\n#define %s_KERNING %d\n", upper, pairs);
+
+	fprintf(stderr, "%s: %d glyphs at %dpt, %u bytes of coverage, %d kerning pairs\n", name,
+		LAST - FIRST + 1, size, (unsigned int)coverage.size(), pairs);
+
+	FT_Done_Face(face);
+	FT_Done_FreeType(lib);
+	return 0;
+}
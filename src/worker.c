@@ -0,0 +1,130 @@
+#include "worker.h"
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+struct lane_t {
+	// head and tail only ever increase, head - tail is the fill level
+	struct worker_msg_t msg[WORKER_QUEUE];
+	uint32_t head;	// written by the lane
+	uint32_t tail;	// written by the UI thread
+
+	// jobs waiting, under lock
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	struct {
+		worker_job_fn fn;
+		int job;
+	} pending[WORKER_PENDING];
+	int first, count;
+
+	bool started;
+	pthread_t thread;
+	int job;		// running now, only used by the lane
+};
+
+static struct lane_t lanes[WORKER_LANES];
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+static uint32_t next_lane = 0;	// where worker_poll() starts, keeps lanes fair
+
+static void lanes_init() {
+	for (int i = 0; i < WORKER_LANES; i++) {
+		pthread_mutex_init(&lanes[i].lock, NULL);
+		pthread_cond_init(&lanes[i].wake, NULL);
+	}
+}
+
+// The lane of the calling thread, NULL outside of the lanes
+static __thread struct lane_t *self;
+
+static bool ring_push(struct lane_t *l, const struct worker_msg_t *msg) {
+	uint32_t head = __atomic_load_n(&l->head, __ATOMIC_RELAXED);
+	if (head - __atomic_load_n(&l->tail, __ATOMIC_ACQUIRE) == WORKER_QUEUE) return false;
+
+	l->msg[head % WORKER_QUEUE] = *msg;
+	__atomic_store_n(&l->head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool ring_pop(struct lane_t *l, struct worker_msg_t *msg) {
+	uint32_t tail = __atomic_load_n(&l->tail, __ATOMIC_RELAXED);
+	if (tail == __atomic_load_n(&l->head, __ATOMIC_ACQUIRE)) return false;
+
+	*msg = l->msg[tail % WORKER_QUEUE];
+	__atomic_store_n(&l->tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool worker_poll(struct worker_msg_t *msg) {
+	for (int i = 0; i < WORKER_LANES; i++) {
+		struct lane_t *l = &lanes[next_lane++ % WORKER_LANES];
+		if (ring_pop(l, msg)) return true;
+	}
+	return false;
+}
+
+void worker_send(struct worker_msg_t *msg) {
+	struct lane_t *l = self;
+	if (l == NULL) return;
+
+	msg->job = l->job;
+	while (!ring_push(l, msg)) usleep(WORKER_FULL_US);
+}
+
+void worker_post(int type, int value) {
+	struct worker_msg_t msg = { type, 0, value, 0, NULL };
+	worker_send(&msg);
+}
+
+static void *lane_main(void *arg) {
+	struct lane_t *l = (struct lane_t *)arg;
+	self = l;
+
+	// SIGINT/SIGTERM quit() from the UI thread, which owns SDL
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	while (1) {
+		pthread_mutex_lock(&l->lock);
+		while (!l->count) pthread_cond_wait(&l->wake, &l->lock);
+		worker_job_fn fn = l->pending[l->first].fn;
+		l->job = l->pending[l->first].job;
+		l->first = (l->first + 1) % WORKER_PENDING;
+		l->count--;
+		pthread_mutex_unlock(&l->lock);
+
+		worker_post(WORKER_START, 0);
+		worker_post(WORKER_DONE, fn(l->job));
+	}
+	return NULL;
+}
+
+int worker_start(int lane, worker_job_fn fn, int job) {
+	if (lane < 0 || lane >= WORKER_LANES) return -1;
+	pthread_once(&lanes_once, lanes_init);
+
+	struct lane_t *l = &lanes[lane];
+	int ret = -1;
+
+	pthread_mutex_lock(&l->lock);
+	if (!l->started) {
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		l->started = pthread_create(&l->thread, &attr, lane_main, l) == 0;
+		pthread_attr_destroy(&attr);
+	}
+	if (l->started && l->count < WORKER_PENDING) {
+		int i = (l->first + l->count) % WORKER_PENDING;
+		l->pending[i].fn = fn;
+		l->pending[i].job = job;
+		l->count++;
+		pthread_cond_signal(&l->wake);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&l->lock);
+	return ret;
+}
@@ -0,0 +1,47 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdint.h>
+
+// Long operations (fsck, formatting, resizing) run on worker threads while
+// the UI thread keeps drawing and reading keys. Jobs are queued on lanes,
+// one thread per card: jobs on one lane run in order, jobs on different
+// lanes at the same time. The workers never touch the screen: every lane
+// reports through its own lock-free single-producer/single-consumer ring,
+// in which only the lane advances head and only the UI thread advances
+// tail.
+
+#define WORKER_LANES	2		// mmcblk0 and mmcblk1
+#define WORKER_PENDING	8		// jobs waiting per lane
+#define WORKER_QUEUE	32		// messages per lane, a power of two
+#define WORKER_FULL_US	10000	// lane backoff while the UI drains the ring
+
+enum worker_msgs {
+	WORKER_START,		// the job left the queue
+	WORKER_TOOL,		// value: card a tool started on, text: its first phase
+	WORKER_PROGRESS,	// value: 1 once the tool exited, text: phase, size: bytes it moves
+	WORKER_DONE,		// value: what the job returned
+};
+
+struct worker_msg_t {
+	int type;
+	int job;			// as passed to worker_start()
+	int value;
+	uint64_t size;
+	const char *text;	// static strings only, the ring copies pointers
+};
+
+typedef int (*worker_job_fn)(int job);
+
+// Queues fn(job) on a lane, fails while WORKER_PENDING jobs are waiting
+int worker_start(int lane, worker_job_fn fn, int job);
+
+// Called by a job, waits while the ring of its lane is full. The job
+// field is filled in.
+void worker_send(struct worker_msg_t *msg);
+void worker_post(int type, int value);
+
+// Called by the UI thread, false when no lane has anything new
+bool worker_poll(struct worker_msg_t *msg);
+
+#endif